@@ -0,0 +1,515 @@
+// Micro/macro benchmarks for the AES-256 / GCM kernels.
+//
+// Build (repo root):
+//   g++ -std=c++17 -O2 -pthread -Isrc bench/bench.cpp src/AES_256.cpp src/AES_Bitslice.cpp
+//       src/AES_NI.cpp src/BufferPool.cpp src/CpuFeatures.cpp src/GCM.cpp src/GCM_CLMUL.cpp src/GCM_Cache.cpp
+//       src/GCM_VAES.cpp src/Instrument.cpp src/Nonce.cpp src/PBKDF2.cpp src/ThreadPool.cpp src/Utils.cpp -o out/gcm-bench
+//
+// Usage:
+//   gcm-bench [--json FILE] [--baseline FILE] [--tolerance PCT] [--filter TEXT]
+//             [--max-size BYTES] [--min-time SEC] [--aes portable|aesni|bitsliced]
+//             [--ghash bitwise|table4|ct|clmul] [--tier sse|avx2|avx512] [--quick]
+//
+// Every case is timed in samples of one or more operations; a case runs until
+// it has --min-time seconds and at least a handful of samples. Reported per
+// case: GB/s and cycles/byte from the mean, and p50/p90/p99 latency of one
+// operation. When a sample batches several operations, the percentiles come
+// from an extra pass that times single calls with the TSC. Cycles come from
+// the TSC on x86 (reference cycles, not core clock under turbo); elsewhere
+// they are left out and single calls are timed with steady_clock.
+//
+// With --baseline, each case is matched by (name, bytes, aad) against a JSON
+// file written earlier with --json; the run fails (exit 1) if any case is more
+// than --tolerance percent (default 10) below the baseline GB/s.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "AES_256.h"
+#include "BufferPool.h"
+#include "CpuFeatures.h"
+#include "GCM.h"
+#include "GCM_Cache.h"
+#include "Nonce.h"
+#include "Utils.h"
+
+#if defined(AESGCM_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10.0;
+    std::string filter;
+    uint64_t maxSize = uint64_t(1) << 30;
+    double minTime = 0.25;
+    AES256::Backend aes = AES256::DefaultBackend();
+    bool ghashSet = false;
+    AES256_GCM::GhashBackend ghash = AES256_GCM::GhashBackend::Clmul;
+    bool tierSet = false;
+    GcmSimdTier tier = GcmSimdTier::Sse;
+};
+
+struct Result {
+    std::string name;
+    uint64_t bytes = 0;
+    uint64_t aad = 0;
+    size_t samples = 0;
+    double gbps = 0;
+    double cpb = 0; // 0 when no cycle counter
+    double p50 = 0, p90 = 0, p99 = 0; // ns per operation
+};
+
+inline uint64_t cycles() {
+#if defined(AESGCM_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+const char* aesName(AES256::Backend b) {
+    switch (b) {
+    case AES256::Backend::Portable: return "portable";
+    case AES256::Backend::AESNI: return "aesni";
+    case AES256::Backend::Bitsliced: return "bitsliced";
+    }
+    return "?";
+}
+
+const char* ghashName(AES256_GCM::GhashBackend b) {
+    switch (b) {
+    case AES256_GCM::GhashBackend::Bitwise: return "bitwise";
+    case AES256_GCM::GhashBackend::Table4: return "table4";
+    case AES256_GCM::GhashBackend::ConstantTime: return "ct";
+    case AES256_GCM::GhashBackend::Clmul: return "clmul";
+    }
+    return "?";
+}
+
+const char* tierName(GcmSimdTier t) {
+    switch (t) {
+    case GcmSimdTier::Sse: return "sse";
+    case GcmSimdTier::Avx2: return "avx2";
+    case GcmSimdTier::Avx512: return "avx512";
+    }
+    return "?";
+}
+
+// Defeat dead-code elimination of benchmarked results
+volatile uint8_t g_sink;
+
+// Run op in samples of `batch` calls until minTime and minSamples are met.
+// bytesPerOp is what throughput is counted against. Percentiles are over
+// single calls, never over batch means.
+Result measure(const std::string& name, uint64_t bytesPerOp, uint64_t aad,
+               double minTime, const std::function<void()>& op) {
+    // calibrate the batch so one sample takes >= ~50 us (timer resolution)
+    size_t batch = 1;
+    for (;;) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < batch; ++i) op();
+        double dt = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (dt >= 50e-6 || batch >= (size_t(1) << 24)) break;
+        batch *= 4;
+    }
+
+    const size_t minSamples = bytesPerOp >= (uint64_t(64) << 20) ? 3 : 10;
+    std::vector<double> perOp; // seconds per operation: sample means, then single-call latencies
+    double total = 0;
+    uint64_t cyc = 0;
+    while (total < minTime || perOp.size() < minSamples) {
+        uint64_t c0 = cycles();
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < batch; ++i) op();
+        double dt = std::chrono::duration<double>(Clock::now() - t0).count();
+        cyc += cycles() - c0;
+        total += dt;
+        perOp.push_back(dt / batch);
+    }
+
+    Result r;
+    r.name = name;
+    r.bytes = bytesPerOp;
+    r.aad = aad;
+    r.samples = perOp.size();
+    double ops = double(batch) * perOp.size();
+    double bytes = double(bytesPerOp) * ops;
+    r.gbps = bytes / total / 1e9;
+    r.cpb = cyc ? double(cyc) / bytes : 0;
+
+    // a batched sample is a mean, so it hides tail latency: time single calls
+    // in a separate pass (the timer cost would skew GB/s), TSC ticks less the
+    // cost of reading the TSC, scaled by the rate seen above; at most as many
+    // calls as the throughput run made
+    if (batch > 1) {
+        size_t calls = std::min(size_t(ops), size_t(1) << 16);
+        double nsPerTick = cyc ? total * 1e9 / double(cyc) : 0;
+        uint64_t timerTicks = UINT64_MAX;
+        for (int i = 0; i < 1000 && nsPerTick; ++i) {
+            uint64_t c0 = cycles();
+            timerTicks = std::min(timerTicks, cycles() - c0);
+        }
+        perOp.assign(calls, 0);
+        for (double& lat : perOp) {
+            if (nsPerTick) {
+                uint64_t c0 = cycles();
+                op();
+                uint64_t dc = cycles() - c0;
+                lat = double(dc > timerTicks ? dc - timerTicks : 0) * nsPerTick * 1e-9;
+            } else {
+                auto t0 = Clock::now();
+                op();
+                lat = std::chrono::duration<double>(Clock::now() - t0).count();
+            }
+        }
+    }
+    std::sort(perOp.begin(), perOp.end());
+    auto pct = [&](double p) {
+        size_t i = std::min(perOp.size() - 1, size_t(p * (perOp.size() - 1) + 0.5));
+        return perOp[i] * 1e9;
+    };
+    r.p50 = pct(0.50);
+    r.p90 = pct(0.90);
+    r.p99 = pct(0.99);
+    return r;
+}
+
+std::vector<uint64_t> messageSizes(uint64_t maxSize) {
+    std::vector<uint64_t> v;
+    for (uint64_t s = 16; s <= maxSize; s *= 4) v.push_back(s);
+    if (v.empty() || v.back() != maxSize) {
+        if (maxSize >= 16) v.push_back(maxSize);
+    }
+    return v;
+}
+
+void fill(std::vector<uint8_t>& v, uint8_t seed) {
+    for (size_t i = 0; i < v.size(); ++i) v[i] = uint8_t(i * 131 + seed);
+}
+
+std::string resultJson(const Result& r) {
+    std::ostringstream o;
+    o << "{\"name\":\"" << r.name << "\",\"bytes\":" << r.bytes << ",\"aad\":" << r.aad
+      << ",\"samples\":" << r.samples << ",\"gbps\":" << r.gbps << ",\"cpb\":" << r.cpb
+      << ",\"p50_ns\":" << r.p50 << ",\"p90_ns\":" << r.p90 << ",\"p99_ns\":" << r.p99 << "}";
+    return o.str();
+}
+
+// Reads back the files written by Suite::WriteJson: one result object per line
+// (aes/ghash/tier come from the header line, to refuse comparing different engines)
+std::map<std::tuple<std::string, uint64_t, uint64_t>, double> loadBaseline(
+    const std::string& path, std::string& aes, std::string& ghash, std::string& tier) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open baseline " + path);
+    std::map<std::tuple<std::string, uint64_t, uint64_t>, double> base;
+    auto field = [](const std::string& line, const std::string& key) -> std::string {
+        size_t p = line.find("\"" + key + "\":");
+        if (p == std::string::npos) return {};
+        p += key.size() + 3;
+        if (line[p] == '"') {
+            size_t e = line.find('"', p + 1);
+            return line.substr(p + 1, e - p - 1);
+        }
+        size_t e = line.find_first_of(",}", p);
+        return line.substr(p, e - p);
+    };
+    for (std::string line; std::getline(in, line);) {
+        if (aes.empty()) aes = field(line, "aes");
+        if (ghash.empty()) ghash = field(line, "ghash");
+        if (tier.empty()) tier = field(line, "tier");
+        std::string name = field(line, "name");
+        std::string gbps = field(line, "gbps");
+        if (name.empty() || gbps.empty()) continue;
+        base[{name, std::stoull(field(line, "bytes")), std::stoull(field(line, "aad"))}] = std::stod(gbps);
+    }
+    if (tier.empty()) tier = "sse"; // recorded before the wide tiers existed
+    return base;
+}
+
+class Suite {
+public:
+    explicit Suite(const Config& cfg) : cfg(cfg), key(32) { fill(key, 7); }
+
+    void Run() {
+        AES256_GCM gcm(key, cfg.aes);
+        Configure(gcm);
+        ghash = gcm.GetGhashBackend();
+        tier = gcm.GetSimdTier();
+        std::vector<uint8_t> iv(12);
+        fill(iv, 3);
+        uint8_t tag[16];
+
+        // --- micro: single block, key setup ---
+        {
+            AES256 aes(key, cfg.aes);
+            uint8_t block[16] = {0};
+            Case("aes_encrypt_block", 16, 0, [&] { aes.EncryptBlock(block); });
+            g_sink = block[0];
+        }
+        Case("gcm_key_setup", 32, 0, [&] {
+            AES256_GCM g(key, cfg.aes);
+            Configure(g);
+            g_sink = uint8_t(g_sink + 1);
+        });
+        {
+            // one 12-byte IV: OS RNG syscall, per-thread buffered generator, counter
+            uint8_t ivb[12];
+            CounterIV counter;
+            Case("iv_os_random", 12, 0, [&] { g_sink = randomBytes(12)[0]; });
+            Case("iv_fast_random", 12, 0, [&] { fastRandomBytes(ivb, 12); g_sink = ivb[0]; });
+            Case("iv_counter", 12, 0, [&] { counter.Next(ivb); g_sink = ivb[11]; });
+        }
+        {
+            // passphrase keys, 1000 iterations (cost is linear in the count):
+            // one derivation, then 8 salts at once on the batch (SIMD lane) engine
+            std::string pass = "bench passphrase";
+            std::vector<std::vector<uint8_t>> salts(8, std::vector<uint8_t>(16));
+            for (size_t i = 0; i < salts.size(); ++i) fill(salts[i], uint8_t(i));
+            Case("pbkdf2_1k", 32, 0, [&] { g_sink = deriveKeyPBKDF2(pass, salts[0], 1000)[0]; });
+            Case("pbkdf2_batch8_1k", 32 * 8, 0, [&] { g_sink = deriveKeysPBKDF2(pass, salts, 1000)[7][0]; });
+        }
+        {
+            // repeat key through the context cache: fingerprint + lookup only
+            AES256_GCM_Cache cache(16, cfg.aes);
+            Case("gcm_cache_hit", 32, 0, [&] {
+                g_sink = uint8_t(g_sink + (cache.Get(key) != nullptr));
+            });
+        }
+
+        // --- sweeps over message size (AAD = 0) ---
+        std::vector<uint64_t> sizes = messageSizes(cfg.maxSize);
+        std::vector<uint8_t> in, out;
+        std::vector<uint8_t> noAad, tagv;
+        BufferPool pool;
+        // same engines with a 128-bit key: 10 rounds instead of 14
+        AES128_GCM gcm128(std::vector<uint8_t>(key.begin(), key.begin() + AES128::KeyBytes), cfg.aes);
+        Configure(gcm128);
+        for (uint64_t s : sizes) {
+            if (!Wanted("ghash") && !Wanted("gcm_encrypt") && !Wanted("gcm_decrypt") &&
+                !Wanted("gcm128_encrypt") && !Wanted("gcm_verify") && !Wanted("gcm_encrypt_vector") &&
+                !Wanted("gcm_encrypt_pooled"))
+                break;
+            in.assign(size_t(s), 0);
+            out.assign(size_t(s), 0);
+            fill(in, 1);
+            Case("ghash", s, 0, [&] {
+                gcm.GHASH(nullptr, 0, in.data(), in.size(), tag);
+                g_sink = tag[0];
+            });
+            Case("gcm_encrypt", s, 0, [&] {
+                gcm.Encrypt(iv.data(), iv.size(), in.data(), in.size(), nullptr, 0, out.data(), tag);
+            });
+            Case("gcm128_encrypt", s, 0, [&] {
+                gcm128.Encrypt(iv.data(), iv.size(), in.data(), in.size(), nullptr, 0, out.data(), tag);
+            });
+            // result buffer per call: fresh std::vector vs a block reused from the pool
+            Case("gcm_encrypt_vector", s, 0, [&] { g_sink = gcm.Encrypt(iv, in, noAad, tagv)[0]; });
+            Case("gcm_encrypt_pooled", s, 0, [&] {
+                g_sink = gcm.Encrypt(iv.data(), iv.size(), in.data(), in.size(), nullptr, 0, tag, pool).Data()[0];
+            });
+            gcm.Encrypt(iv.data(), iv.size(), in.data(), in.size(), nullptr, 0, out.data(), tag);
+            Case("gcm_decrypt", s, 0, [&] {
+                gcm.Decrypt(iv.data(), iv.size(), out.data(), out.size(), nullptr, 0, tag, in.data());
+            });
+            Case("gcm_verify", s, 0, [&] {
+                g_sink = gcm.Verify(iv.data(), iv.size(), out.data(), out.size(), nullptr, 0, tag);
+            });
+        }
+        in.clear();
+        in.shrink_to_fit();
+        out.clear();
+        out.shrink_to_fit();
+
+        // --- AAD sweep: 1 KiB record, AAD 0 .. 1 MiB ---
+        std::vector<uint8_t> msg(1024), ct(1024);
+        fill(msg, 5);
+        for (uint64_t a : {uint64_t(0), uint64_t(16), uint64_t(256), uint64_t(4096),
+                           uint64_t(65536), uint64_t(1) << 20}) {
+            std::vector<uint8_t> aad(static_cast<size_t>(a));
+            fill(aad, 9);
+            Case("gcm_encrypt_aad", msg.size() + a, a, [&] {
+                gcm.Encrypt(iv.data(), iv.size(), msg.data(), msg.size(), aad.data(), aad.size(), ct.data(), tag);
+            });
+        }
+        // --- small records: one Encrypt per record vs EncryptBatch (256 records);
+        // 1 KiB is above BatchMaxRecordBytes, so EncryptBatch takes the
+        // single-message path per record (reported as _ungrouped) ---
+        for (uint64_t r : {uint64_t(64), uint64_t(256), uint64_t(1024)}) {
+            const size_t count = 256;
+            std::vector<uint8_t> recs(size_t(r) * count), outs(recs.size()), tags(16 * count), ivs(12 * count);
+            fill(recs, 2);
+            fill(ivs, 4);
+            std::vector<AES256_GCM::BatchItem> items(count);
+            for (size_t i = 0; i < count; ++i) {
+                items[i] = {&ivs[12 * i], &recs[r * i], size_t(r), nullptr, 0, &outs[r * i], &tags[16 * i]};
+            }
+            Case("gcm_encrypt_records", r * count, 0, [&] {
+                for (const auto& it : items) gcm.Encrypt(it.iv, 12, it.in, it.len, nullptr, 0, it.out, it.tag);
+            });
+            Case(r <= AES256_GCM::BatchMaxRecordBytes ? "gcm_encrypt_batch" : "gcm_encrypt_batch_ungrouped",
+                 r * count, 0, [&] { gcm.EncryptBatch(items.data(), items.size()); });
+        }
+    }
+
+    // One result object per line, so loadBaseline can read it back without a JSON parser
+    void WriteJson(std::ostream& o) const {
+        const CpuFeatures& cpu = GetCpuFeatures();
+        o << "{\n\"aes\":\"" << aesName(cfg.aes) << "\",\"ghash\":\"" << ghashName(ghash)
+          << "\",\"tier\":\"" << tierName(tier)
+          << "\",\"cpu\":{\"aesni\":" << cpu.aesni << ",\"pclmul\":" << cpu.pclmul
+          << ",\"ssse3\":" << cpu.ssse3 << ",\"sse41\":" << cpu.sse41 << ",\"avx2\":" << cpu.avx2
+          << ",\"avx512\":" << cpu.avx512 << ",\"vaes\":" << cpu.vaes << ",\"vpclmul\":" << cpu.vpclmul
+          << "},\n\"results\":[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            o << resultJson(results[i]) << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        o << "]\n}\n";
+    }
+
+    // Returns the number of cases slower than baseline by more than tolerance
+    int CheckBaseline(const std::string& path) const {
+        std::string baseAes, baseGhash, baseTier;
+        auto base = loadBaseline(path, baseAes, baseGhash, baseTier);
+        if (baseAes != aesName(cfg.aes) || baseGhash != ghashName(ghash) || baseTier != tierName(tier)) {
+            throw std::runtime_error("baseline " + path + " was recorded with aes=" + baseAes +
+                                     " ghash=" + baseGhash + " tier=" + baseTier +
+                                     "; rerun with matching --aes/--ghash/--tier");
+        }
+        int regressions = 0;
+        for (const Result& r : results) {
+            auto it = base.find({r.name, r.bytes, r.aad});
+            if (it == base.end() || it->second <= 0) continue;
+            double change = (r.gbps / it->second - 1.0) * 100.0;
+            if (change < -cfg.tolerance) {
+                ++regressions;
+                std::fprintf(stderr, "REGRESSION %-18s bytes=%-11llu aad=%-8llu %.3f -> %.3f GB/s (%+.1f%%)\n",
+                             r.name.c_str(), (unsigned long long)r.bytes, (unsigned long long)r.aad,
+                             it->second, r.gbps, change);
+            }
+        }
+        return regressions;
+    }
+
+private:
+    const Config& cfg;
+    std::vector<uint8_t> key;
+    AES256_GCM::GhashBackend ghash = AES256_GCM::GhashBackend::Bitwise;
+    GcmSimdTier tier = GcmSimdTier::Sse;
+    std::vector<Result> results;
+
+    // --ghash / --tier on every engine a case builds
+    template <class G>
+    void Configure(G& g) const {
+        if (cfg.ghashSet) g.SetGhashBackend(cfg.ghash);
+        if (cfg.tierSet) g.SetSimdTier(cfg.tier);
+    }
+
+    bool Wanted(const std::string& name) const {
+        return cfg.filter.empty() || name.find(cfg.filter) != std::string::npos;
+    }
+
+    // Time one case (if it passes --filter), print it and keep it for the JSON
+    void Case(const std::string& name, uint64_t bytes, uint64_t aad, const std::function<void()>& op) {
+        if (!Wanted(name)) return;
+        Result r = measure(name, bytes, aad, cfg.minTime, op);
+        results.push_back(r);
+        std::fprintf(stderr, "%-18s bytes=%-11llu aad=%-8llu %9.3f GB/s %8.2f c/B  p50 %12.0f ns  p99 %12.0f ns\n",
+                     r.name.c_str(), (unsigned long long)r.bytes, (unsigned long long)r.aad,
+                     r.gbps, r.cpb, r.p50, r.p99);
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Config cfg;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string a = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("missing value for " + a);
+                return argv[++i];
+            };
+            if (a == "--json") cfg.jsonPath = value();
+            else if (a == "--baseline") cfg.baselinePath = value();
+            else if (a == "--tolerance") cfg.tolerance = std::stod(value());
+            else if (a == "--filter") cfg.filter = value();
+            else if (a == "--max-size") cfg.maxSize = std::stoull(value());
+            else if (a == "--min-time") cfg.minTime = std::stod(value());
+            else if (a == "--quick") { cfg.maxSize = uint64_t(1) << 20; cfg.minTime = 0.05; }
+            else if (a == "--aes") {
+                std::string v = value();
+                if (v == "portable") cfg.aes = AES256::Backend::Portable;
+                else if (v == "aesni") cfg.aes = AES256::Backend::AESNI;
+                else if (v == "bitsliced") cfg.aes = AES256::Backend::Bitsliced;
+                else throw std::invalid_argument("unknown AES backend " + v);
+            } else if (a == "--ghash") {
+                std::string v = value();
+                cfg.ghashSet = true;
+                if (v == "bitwise") cfg.ghash = AES256_GCM::GhashBackend::Bitwise;
+                else if (v == "table4") cfg.ghash = AES256_GCM::GhashBackend::Table4;
+                else if (v == "ct") cfg.ghash = AES256_GCM::GhashBackend::ConstantTime;
+                else if (v == "clmul") cfg.ghash = AES256_GCM::GhashBackend::Clmul;
+                else throw std::invalid_argument("unknown GHASH backend " + v);
+            } else if (a == "--tier") {
+                std::string v = value();
+                cfg.tierSet = true;
+                if (v == "sse") cfg.tier = GcmSimdTier::Sse;
+                else if (v == "avx2") cfg.tier = GcmSimdTier::Avx2;
+                else if (v == "avx512") cfg.tier = GcmSimdTier::Avx512;
+                else throw std::invalid_argument("unknown SIMD tier " + v);
+            } else {
+                throw std::invalid_argument("unknown option " + a);
+            }
+        }
+
+        Suite suite(cfg);
+        suite.Run();
+
+        if (cfg.jsonPath.empty()) {
+            suite.WriteJson(std::cout);
+        } else {
+            std::ofstream out(cfg.jsonPath);
+            if (!out) throw std::runtime_error("cannot write " + cfg.jsonPath);
+            suite.WriteJson(out);
+        }
+
+        if (!cfg.baselinePath.empty()) {
+            int n = suite.CheckBaseline(cfg.baselinePath);
+            if (n) {
+                std::fprintf(stderr, "%d case(s) regressed more than %.1f%% against %s\n",
+                             n, cfg.tolerance, cfg.baselinePath.c_str());
+                return 1;
+            }
+            std::fprintf(stderr, "No regressions against %s\n", cfg.baselinePath.c_str());
+        }
+    } catch (const std::exception& ex) {
+        std::fprintf(stderr, "gcm-bench: %s\n", ex.what());
+        return 2;
+    }
+    return 0;
+}
@@ -1,9 +1,20 @@
 #include "AES_256.h"
+#include "AES_Bitslice.h"
+#include "AES_NI.h"
+#include "CpuFeatures.h"
+#include "Instrument.h"
+#include "SecureZero.h"
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
 
 // === S-box, inv S-box, Rcon (từ chuẩn AES) ===
-const uint8_t AES256::sbox[256] = {
+// Shared by every key size; constexpr so the T-tables below are built at compile time
+constexpr uint8_t sbox[256] = {
   0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
   0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
   0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
@@ -22,7 +33,7 @@ const uint8_t AES256::sbox[256] = {
   0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16
 };
 
-const uint8_t AES256::inv_sbox[256] = {
+constexpr uint8_t inv_sbox[256] = {
   0x52,0x09,0x6a,0xd5,0x30,0x36,0xa5,0x38,0xbf,0x40,0xa3,0x9e,0x81,0xf3,0xd7,0xfb,
   0x7c,0xe3,0x39,0x82,0x9b,0x2f,0xff,0x87,0x34,0x8e,0x43,0x44,0xc4,0xde,0xe9,0xcb,
   0x54,0x7b,0x94,0x32,0xa6,0xc2,0x23,0x3d,0xee,0x4c,0x95,0x0b,0x42,0xfa,0xc3,0x4e,
@@ -41,13 +52,13 @@ const uint8_t AES256::inv_sbox[256] = {
   0x17,0x2b,0x04,0x7e,0xba,0x77,0xd6,0x26,0xe1,0x69,0x14,0x63,0x55,0x21,0x0c,0x7d
 };
 
-const uint8_t AES256::Rcon[15] = {
+constexpr uint8_t Rcon[15] = {
   0x00,0x01,0x02,0x04,0x08,0x10,0x20,0x40,0x80,0x1B,0x36,0x6C,0xD8,0xAB,0x4D
 };
 
 // Helper: xtime and multiply in GF(2^8)
-static inline uint8_t xtime_local(uint8_t x) { return (uint8_t)((x << 1) ^ (((x >> 7) & 1) ? 0x1B : 0x00)); }
-static inline uint8_t mul_local(uint8_t a, uint8_t b) {
+constexpr uint8_t xtime_local(uint8_t x) { return (uint8_t)((x << 1) ^ (((x >> 7) & 1) ? 0x1B : 0x00)); }
+inline uint8_t mul_local(uint8_t a, uint8_t b) {
     uint8_t r = 0;
     while (b) {
         if (b & 1) r ^= a;
@@ -57,19 +68,76 @@ static inline uint8_t mul_local(uint8_t a, uint8_t b) {
     return r;
 }
 
-// Key expansion: generate 240 bytes (4*(Nr+1)*4) for AES-256 (Nr=14 => 60 words => 240 bytes)
-void AES256::KeyExpansion(const std::vector<uint8_t>& key) {
-    if (key.size() != 32) throw std::invalid_argument("AES-256 key must be 32 bytes");
-    // roundKeys is std::array<uint8_t,240>
-    // copy initial key (32 bytes)
-    std::memcpy(roundKeys.data(), key.data(), 32);
+constexpr uint32_t rotr32(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
 
-    int Nk = 8;   // words in key
-    int Nr = 14;
-    int words = 4 * (Nr + 1); // 60 words
-    uint8_t temp[4];
+inline uint32_t load_be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+// === T-tables: SubBytes + ShiftRows + MixColumns merged into 32-bit lookups ===
+// Te0[x] = (2*S[x], S[x], S[x], 3*S[x]) as a big-endian word; Te1..Te3 are the
+// same column rotated right by 8/16/24 bits, so one round of one column is
+// four lookups and four XORs instead of 16 byte ops + 16 GF multiplies.
+constexpr std::array<std::array<uint32_t, 256>, 4> BuildTTables() {
+    std::array<std::array<uint32_t, 256>, 4> t{};
+    for (int x = 0; x < 256; ++x) {
+        uint8_t s = sbox[x];
+        uint8_t s2 = xtime_local(s);
+        uint8_t s3 = static_cast<uint8_t>(s2 ^ s);
+        uint32_t w = (uint32_t(s2) << 24) | (uint32_t(s) << 16) | (uint32_t(s) << 8) | s3;
+        t[0][x] = w;
+        t[1][x] = rotr32(w, 8);
+        t[2][x] = rotr32(w, 16);
+        t[3][x] = rotr32(w, 24);
+    }
+    return t;
+}
+
+constexpr std::array<std::array<uint32_t, 256>, 4> Te = BuildTTables();
 
-    for (int i = Nk; i < words; ++i) {
+// One middle round (SubBytes, ShiftRows, MixColumns, AddRoundKey rk) on the
+// big-endian columns s0..s3; ShiftRows is folded into which column each
+// table lookup reads from. Forced inline: GCC stops inlining after a few of
+// the 9..13 copies, and the columns then spill between rounds.
+AESGCM_INLINE void TRound(const uint32_t* rk, uint32_t& s0, uint32_t& s1, uint32_t& s2, uint32_t& s3) {
+    const uint32_t* Te0 = Te[0].data();
+    const uint32_t* Te1 = Te[1].data();
+    const uint32_t* Te2 = Te[2].data();
+    const uint32_t* Te3 = Te[3].data();
+    uint32_t t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xff] ^ Te2[(s2 >> 8) & 0xff] ^ Te3[s3 & 0xff] ^ rk[0];
+    uint32_t t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xff] ^ Te2[(s3 >> 8) & 0xff] ^ Te3[s0 & 0xff] ^ rk[1];
+    uint32_t t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xff] ^ Te2[(s0 >> 8) & 0xff] ^ Te3[s1 & 0xff] ^ rk[2];
+    uint32_t t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xff] ^ Te2[(s1 >> 8) & 0xff] ^ Te3[s2 & 0xff] ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+}
+
+// Rounds 1..sizeof...(R) expanded at compile time: no loop counter, and the
+// four columns stay in registers from the first round to the last
+template <size_t... R>
+inline void TRounds(const uint32_t* rk, uint32_t& s0, uint32_t& s1, uint32_t& s2, uint32_t& s3,
+                    std::index_sequence<R...>) {
+    (TRound(rk + 4 * (R + 1), s0, s1, s2, s3), ...);
+}
+
+} // namespace
+
+// Key expansion (FIPS-197 5.2): 4 * (Nr + 1) words from the Nk-word key
+template <int KeyBits>
+void AES<KeyBits>::KeyExpansion(const std::vector<uint8_t>& key) {
+    if (key.size() != KeyBytes)
+        throw std::invalid_argument("AES-" + std::to_string(KeyBits) + " key must be " +
+                                    std::to_string(KeyBytes) + " bytes");
+    std::memcpy(roundKeys.data(), key.data(), KeyBytes);
+
+    uint8_t temp[4];
+    for (int i = Nk; i < ScheduleWords; ++i) {
         // temp = word[i-1]
         temp[0] = roundKeys[4*(i-1) + 0];
         temp[1] = roundKeys[4*(i-1) + 1];
@@ -83,19 +151,11 @@ void AES256::KeyExpansion(const std::vector<uint8_t>& key) {
             temp[1] = temp[2];
             temp[2] = temp[3];
             temp[3] = t;
-            // SubWord
-            temp[0] = sbox[temp[0]];
-            temp[1] = sbox[temp[1]];
-            temp[2] = sbox[temp[2]];
-            temp[3] = sbox[temp[3]];
+            SubWord(temp);
             // Rcon
             temp[0] ^= Rcon[i / Nk];
         } else if (Nk > 6 && (i % Nk == 4)) {
-            // SubWord
-            temp[0] = sbox[temp[0]];
-            temp[1] = sbox[temp[1]];
-            temp[2] = sbox[temp[2]];
-            temp[3] = sbox[temp[3]];
+            SubWord(temp);
         }
         // word[i] = word[i-Nk] ^ temp
         roundKeys[4*i + 0] = roundKeys[4*(i - Nk) + 0] ^ temp[0];
@@ -103,10 +163,28 @@ void AES256::KeyExpansion(const std::vector<uint8_t>& key) {
         roundKeys[4*i + 2] = roundKeys[4*(i - Nk) + 2] ^ temp[2];
         roundKeys[4*i + 3] = roundKeys[4*(i - Nk) + 3] ^ temp[3];
     }
+
+    // pack once here so EncryptBlock never touches the byte schedule
+    for (int i = 0; i < ScheduleWords; ++i) rkWords[i] = load_be32(roundKeys.data() + 4 * i);
+    Bitslice_KeySchedule(roundKeys.data(), Nr, bsKeys.data());
+}
+
+// SubWord: table lookup, or the bitsliced circuit when the engine must stay constant-time
+template <int KeyBits>
+void AES<KeyBits>::SubWord(uint8_t w[4]) const {
+    if (backend == Backend::Bitsliced) {
+        Bitslice_SubWord(w);
+        return;
+    }
+    w[0] = sbox[w[0]];
+    w[1] = sbox[w[1]];
+    w[2] = sbox[w[2]];
+    w[3] = sbox[w[3]];
 }
 
 // state is 4x4 column-major
-void AES256::AddRoundKey(uint8_t state[4][4], int round) const {
+template <int KeyBits>
+void AES<KeyBits>::AddRoundKey(uint8_t state[4][4], int round) const {
     // roundKeys stored as bytes; each round uses 16 bytes starting at round*16
     const uint8_t* rk = roundKeys.data() + round * 16;
     for (int c = 0; c < 4; ++c) {
@@ -116,42 +194,15 @@ void AES256::AddRoundKey(uint8_t state[4][4], int round) const {
     }
 }
 
-void AES256::SubBytes(uint8_t state[4][4]) const {
-    for (int r = 0; r < 4; ++r)
-        for (int c = 0; c < 4; ++c)
-            state[r][c] = sbox[state[r][c]];
-}
-
-void AES256::InvSubBytes(uint8_t state[4][4]) const {
+template <int KeyBits>
+void AES<KeyBits>::InvSubBytes(uint8_t state[4][4]) const {
     for (int r = 0; r < 4; ++r)
         for (int c = 0; c < 4; ++c)
             state[r][c] = inv_sbox[state[r][c]];
 }
 
-void AES256::ShiftRows(uint8_t state[4][4]) const {
-    // row 1 rotate left by 1
-    uint8_t tmp;
-    tmp = state[1][0];
-    state[1][0] = state[1][1];
-    state[1][1] = state[1][2];
-    state[1][2] = state[1][3];
-    state[1][3] = tmp;
-    // row 2 rotate left by 2
-    tmp = state[2][0];
-    state[2][0] = state[2][2];
-    state[2][2] = tmp;
-    tmp = state[2][1];
-    state[2][1] = state[2][3];
-    state[2][3] = tmp;
-    // row 3 rotate left by 3 (or right by 1)
-    tmp = state[3][3];
-    state[3][3] = state[3][2];
-    state[3][2] = state[3][1];
-    state[3][1] = state[3][0];
-    state[3][0] = tmp;
-}
-
-void AES256::InvShiftRows(uint8_t state[4][4]) const {
+template <int KeyBits>
+void AES<KeyBits>::InvShiftRows(uint8_t state[4][4]) const {
     uint8_t tmp;
     // row1 rotate right by 1
     tmp = state[1][3];
@@ -174,18 +225,8 @@ void AES256::InvShiftRows(uint8_t state[4][4]) const {
     state[3][3] = tmp;
 }
 
-void AES256::MixColumns(uint8_t state[4][4]) const {
-    for (int c = 0; c < 4; ++c) {
-        uint8_t a0 = state[0][c], a1 = state[1][c], a2 = state[2][c], a3 = state[3][c];
-        uint8_t r0 = (uint8_t)(mul_local(a0,2) ^ mul_local(a1,3) ^ a2 ^ a3);
-        uint8_t r1 = (uint8_t)(a0 ^ mul_local(a1,2) ^ mul_local(a2,3) ^ a3);
-        uint8_t r2 = (uint8_t)(a0 ^ a1 ^ mul_local(a2,2) ^ mul_local(a3,3));
-        uint8_t r3 = (uint8_t)(mul_local(a0,3) ^ a1 ^ a2 ^ mul_local(a3,2));
-        state[0][c] = r0; state[1][c] = r1; state[2][c] = r2; state[3][c] = r3;
-    }
-}
-
-void AES256::InvMixColumns(uint8_t state[4][4]) const {
+template <int KeyBits>
+void AES<KeyBits>::InvMixColumns(uint8_t state[4][4]) const {
     for (int c = 0; c < 4; ++c) {
         uint8_t a0 = state[0][c], a1 = state[1][c], a2 = state[2][c], a3 = state[3][c];
         uint8_t r0 = (uint8_t)(mul_local(a0,0x0e) ^ mul_local(a1,0x0b) ^ mul_local(a2,0x0d) ^ mul_local(a3,0x09));
@@ -196,37 +237,59 @@ void AES256::InvMixColumns(uint8_t state[4][4]) const {
     }
 }
 
-// Encrypt single 16-byte block in-place
-void AES256::EncryptBlock(uint8_t* block) const {
+// Encrypt single 16-byte block in-place (T-table round engine).
+// Columns are big-endian words s0..s3; ShiftRows is folded into which column
+// each table lookup reads from.
+template <int KeyBits>
+void AES<KeyBits>::EncryptBlock(uint8_t* block) const {
     if (!block) return;
-    uint8_t state[4][4];
-    // load block into state (column-major)
-    for (int i = 0; i < 16; ++i) state[i % 4][i / 4] = block[i];
-
-    AddRoundKey(state, 0);
-    for (int round = 1; round <= 13; ++round) {
-        SubBytes(state);
-        ShiftRows(state);
-        MixColumns(state);
-        AddRoundKey(state, round);
+    if (backend == Backend::AESNI) {
+        AESNI_EncryptBlock(roundKeys.data(), Nr, block, block);
+        return;
+    }
+    if (backend == Backend::Bitsliced) {
+        // one real lane in an 8-block batch; slower, but no table lookups
+        uint8_t batch[128] = {0};
+        std::memcpy(batch, block, 16);
+        Bitslice_Encrypt8(bsKeys.data(), Nr, batch, batch);
+        std::memcpy(block, batch, 16);
+        return;
     }
-    // final round
-    SubBytes(state);
-    ShiftRows(state);
-    AddRoundKey(state, 14);
+    const uint32_t* rk = rkWords.data();
+    uint32_t s0 = load_be32(block +  0) ^ rk[0];
+    uint32_t s1 = load_be32(block +  4) ^ rk[1];
+    uint32_t s2 = load_be32(block +  8) ^ rk[2];
+    uint32_t s3 = load_be32(block + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
 
-    // store back
-    for (int i = 0; i < 16; ++i) block[i] = state[i % 4][i / 4];
+    TRounds(rk, s0, s1, s2, s3, std::make_index_sequence<Nr - 1>());
+
+    // final round: SubBytes + ShiftRows + AddRoundKey (no MixColumns)
+    rk += 4 * Nr;
+    t0 = (uint32_t(sbox[s0 >> 24]) << 24) ^ (uint32_t(sbox[(s1 >> 16) & 0xff]) << 16) ^
+         (uint32_t(sbox[(s2 >> 8) & 0xff]) << 8) ^ uint32_t(sbox[s3 & 0xff]) ^ rk[0];
+    t1 = (uint32_t(sbox[s1 >> 24]) << 24) ^ (uint32_t(sbox[(s2 >> 16) & 0xff]) << 16) ^
+         (uint32_t(sbox[(s3 >> 8) & 0xff]) << 8) ^ uint32_t(sbox[s0 & 0xff]) ^ rk[1];
+    t2 = (uint32_t(sbox[s2 >> 24]) << 24) ^ (uint32_t(sbox[(s3 >> 16) & 0xff]) << 16) ^
+         (uint32_t(sbox[(s0 >> 8) & 0xff]) << 8) ^ uint32_t(sbox[s1 & 0xff]) ^ rk[2];
+    t3 = (uint32_t(sbox[s3 >> 24]) << 24) ^ (uint32_t(sbox[(s0 >> 16) & 0xff]) << 16) ^
+         (uint32_t(sbox[(s1 >> 8) & 0xff]) << 8) ^ uint32_t(sbox[s2 & 0xff]) ^ rk[3];
+
+    store_be32(block +  0, t0);
+    store_be32(block +  4, t1);
+    store_be32(block +  8, t2);
+    store_be32(block + 12, t3);
 }
 
 // Decrypt single 16-byte block in-place
-void AES256::DecryptBlock(uint8_t* block) const {
+template <int KeyBits>
+void AES<KeyBits>::DecryptBlock(uint8_t* block) const {
     if (!block) return;
     uint8_t state[4][4];
     for (int i = 0; i < 16; ++i) state[i % 4][i / 4] = block[i];
 
-    AddRoundKey(state, 14);
-    for (int round = 13; round >= 1; --round) {
+    AddRoundKey(state, Nr);
+    for (int round = Nr - 1; round >= 1; --round) {
         InvShiftRows(state);
         InvSubBytes(state);
         AddRoundKey(state, round);
@@ -238,6 +301,100 @@ void AES256::DecryptBlock(uint8_t* block) const {
 
     for (int i = 0; i < 16; ++i) block[i] = state[i % 4][i / 4];
 }
-AES256::AES256(const std::vector<uint8_t>& key) {
+template <int KeyBits>
+void AES<KeyBits>::EncryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    if (backend == Backend::AESNI) {
+        AESNI_EncryptBlocks(roundKeys.data(), Nr, in, out, nblocks);
+        return;
+    }
+    if (backend == Backend::Bitsliced) {
+        uint8_t batch[128];
+        while (nblocks > 0) {
+            size_t n = std::min<size_t>(nblocks, 8);
+            std::memcpy(batch, in, n * 16);
+            if (n < 8) std::memset(batch + n * 16, 0, (8 - n) * 16);
+            Bitslice_Encrypt8(bsKeys.data(), Nr, batch, batch);
+            std::memcpy(out, batch, n * 16);
+            in += n * 16;
+            out += n * 16;
+            nblocks -= n;
+        }
+        return;
+    }
+    for (size_t i = 0; i < nblocks; ++i) {
+        if (out != in) std::memcpy(out + i * 16, in + i * 16, 16);
+        EncryptBlock(out + i * 16);
+    }
+}
+
+template <int KeyBits>
+void AES<KeyBits>::EncryptCtr32(uint8_t counter[16], const uint8_t* in, uint8_t* out, size_t len) const {
+    size_t full = len / 16;
+    size_t tail = len % 16;
+    if (backend == Backend::AESNI) {
+        AESNI_Ctr32(roundKeys.data(), Nr, counter, in, out, full);
+    } else if (backend == Backend::Bitsliced) {
+        Bitslice_Ctr32(bsKeys.data(), Nr, counter, in, out, full);
+    } else {
+        uint8_t ks[16];
+        for (size_t i = 0; i < full; ++i) {
+            std::memcpy(ks, counter, 16);
+            EncryptBlock(ks);
+            for (int j = 0; j < 16; ++j) out[i * 16 + j] = in[i * 16 + j] ^ ks[j];
+            store_be32(counter + 12, load_be32(counter + 12) + 1);
+        }
+    }
+    if (tail) {
+        uint8_t ks[16];
+        std::memcpy(ks, counter, 16);
+        EncryptBlock(ks);
+        for (size_t j = 0; j < tail; ++j) out[full * 16 + j] = in[full * 16 + j] ^ ks[j];
+        store_be32(counter + 12, load_be32(counter + 12) + 1);
+    }
+}
+
+template <int KeyBits>
+bool AES<KeyBits>::BackendSupported(Backend b) {
+    switch (b) {
+    case Backend::Portable:
+    case Backend::Bitsliced: return true;
+    case Backend::AESNI: {
+        const CpuFeatures& cpu = GetCpuFeatures();
+        return cpu.aesni && cpu.ssse3 && cpu.sse41;
+    }
+    }
+    return false;
+}
+
+template <int KeyBits>
+void AES<KeyBits>::SetBackend(Backend b) {
+    if (!BackendSupported(b)) throw std::invalid_argument("AES backend not supported on this CPU");
+    backend = b;
+}
+
+template <int KeyBits>
+AesBackend AES<KeyBits>::DefaultBackend() {
+    return BackendSupported(Backend::AESNI) ? Backend::AESNI : Backend::Portable;
+}
+
+template <int KeyBits>
+AES<KeyBits>::AES(const std::vector<uint8_t>& key)
+    : AES(key, DefaultBackend()) {}
+
+template <int KeyBits>
+AES<KeyBits>::AES(const std::vector<uint8_t>& key, Backend backend) {
+    AESGCM_PHASE(GcmPhase::AesKeySchedule, KeyBytes, 0, 0);
+    SetBackend(backend); // before KeyExpansion so SubWord follows the engine
     KeyExpansion(key);
-}
\ No newline at end of file
+}
+
+template <int KeyBits>
+AES<KeyBits>::~AES() {
+    SecureZero(roundKeys.data(), sizeof(roundKeys));
+    SecureZero(rkWords.data(), sizeof(rkWords));
+    SecureZero(bsKeys.data(), sizeof(bsKeys));
+}
+
+template class AES<128>;
+template class AES<192>;
+template class AES<256>;
@@ -2,34 +2,81 @@
 #define AES_256_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
-class AES256 {
+// Encryption engine, shared by every key size. Portable = T-tables, AESNI =
+// hardware, Bitsliced = constant-time software (no secret-indexed loads, 8
+// blocks per batch).
+enum class AesBackend { Portable, AESNI, Bitsliced };
+
+template <class Cipher> class AES_GCM;
+
+// AES with the key size fixed at compile time (KeyBits = 128, 192 or 256).
+// Round count and schedule layout are constants, so the T-table rounds are
+// unrolled and kept in registers. Instantiated for the three sizes in
+// AES_256.cpp; use the AES128 / AES192 / AES256 aliases.
+template <int KeyBits>
+class AES {
+    static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256,
+                  "AES key size must be 128, 192 or 256 bits");
+
 public:
-    AES256(const std::vector<uint8_t>& key);
+    using Backend = AesBackend;
+
+    static constexpr size_t KeyBytes = KeyBits / 8;
+    static constexpr int Nk = KeyBits / 32; // key words
+    static constexpr int Nr = Nk + 6;       // rounds
+    static constexpr int ScheduleWords = 4 * (Nr + 1);
+
+    // Picks DefaultBackend()
+    AES(const std::vector<uint8_t>& key);
+    // With Backend::Bitsliced the key schedule itself is computed in constant time
+    AES(const std::vector<uint8_t>& key, Backend backend);
+    // Zeroizes the key schedules
+    ~AES();
     void EncryptBlock(uint8_t* block) const;
     void DecryptBlock(uint8_t* block) const;
 
+    // Encrypt nblocks independent 16-byte blocks (ECB) from in to out; in may
+    // equal out. Hardware and bitsliced backends keep 8 blocks in flight.
+    void EncryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+
+    // CTR keystream XOR with GCM's inc32 counter (bytes 12..15, big-endian).
+    // Uses counter, counter+1, ... for ceil(len/16) blocks (the last one may be
+    // partial) and leaves counter at the next unused value. in may equal out.
+    void EncryptCtr32(uint8_t counter[16], const uint8_t* in, uint8_t* out, size_t len) const;
+
+    Backend GetBackend() const { return backend; }
+    // Force a backend (tests/benchmarks); throws std::invalid_argument if the CPU lacks it
+    void SetBackend(Backend b);
+    static bool BackendSupported(Backend b);
+    // AESNI when available, otherwise Portable
+    static Backend DefaultBackend();
+
 private:
-    std::array<uint8_t, 240> roundKeys; // 240 bytes for AES-256
+    template <class> friend class AES_GCM; // stitched GCM kernels drive the AES-NI rounds directly
+
+    std::array<uint8_t, 4 * ScheduleWords> roundKeys; // FIPS-197 byte schedule
+    std::array<uint32_t, ScheduleWords> rkWords;      // same schedule packed as big-endian words (T-table path)
+    std::array<uint64_t, 8 * (Nr + 1)> bsKeys;        // bitsliced schedule (Bitsliced backend)
+    Backend backend = Backend::Portable;
 
     void KeyExpansion(const std::vector<uint8_t>& key);
+    void SubWord(uint8_t w[4]) const;
     void AddRoundKey(uint8_t state[4][4], int round) const;
-    void SubBytes(uint8_t state[4][4]) const;
-    void ShiftRows(uint8_t state[4][4]) const;
-    void MixColumns(uint8_t state[4][4]) const;
-
     void InvSubBytes(uint8_t state[4][4]) const;
     void InvShiftRows(uint8_t state[4][4]) const;
     void InvMixColumns(uint8_t state[4][4]) const;
+};
 
-    static uint8_t xtime(uint8_t x);
-    static uint8_t Multiply(uint8_t x, uint8_t y);
+using AES128 = AES<128>;
+using AES192 = AES<192>;
+using AES256 = AES<256>;
 
-    static const uint8_t sbox[256];
-    static const uint8_t inv_sbox[256];
-    static const uint8_t Rcon[15];
-};
+extern template class AES<128>;
+extern template class AES<192>;
+extern template class AES<256>;
 
 #endif
@@ -0,0 +1,385 @@
+#include "AES_Bitslice.h"
+#include <cstring>
+
+namespace {
+
+inline uint32_t load_le32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline void store_le32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+// AES S-box as a boolean circuit over 8 bit-planes (q[0] = LSB plane)
+void Sbox(uint64_t* q) {
+    uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint64_t y20, y21;
+    uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    // top linear transformation
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    // non-linear section (inversion in GF(2^8) via GF(2^4))
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    // bottom linear transformation
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+// Transpose between "byte per word" and "bit-plane per word" (its own inverse)
+void Ortho(uint64_t* q) {
+    auto swapn = [](uint64_t cl, uint64_t ch, int s, uint64_t& x, uint64_t& y) {
+        uint64_t a = x, b = y;
+        x = (a & cl) | ((b & cl) << s);
+        y = ((a & ch) >> s) | (b & ch);
+    };
+    const uint64_t m2l = 0x5555555555555555ULL, m2h = 0xAAAAAAAAAAAAAAAAULL;
+    const uint64_t m4l = 0x3333333333333333ULL, m4h = 0xCCCCCCCCCCCCCCCCULL;
+    const uint64_t m8l = 0x0F0F0F0F0F0F0F0FULL, m8h = 0xF0F0F0F0F0F0F0F0ULL;
+
+    swapn(m2l, m2h, 1, q[0], q[1]);
+    swapn(m2l, m2h, 1, q[2], q[3]);
+    swapn(m2l, m2h, 1, q[4], q[5]);
+    swapn(m2l, m2h, 1, q[6], q[7]);
+
+    swapn(m4l, m4h, 2, q[0], q[2]);
+    swapn(m4l, m4h, 2, q[1], q[3]);
+    swapn(m4l, m4h, 2, q[4], q[6]);
+    swapn(m4l, m4h, 2, q[5], q[7]);
+
+    swapn(m8l, m8h, 4, q[0], q[4]);
+    swapn(m8l, m8h, 4, q[1], q[5]);
+    swapn(m8l, m8h, 4, q[2], q[6]);
+    swapn(m8l, m8h, 4, q[3], q[7]);
+}
+
+// Spread one block (four little-endian words) over two state words
+void InterleaveIn(uint64_t& q0, uint64_t& q1, const uint32_t* w) {
+    uint64_t x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+    x0 |= (x0 << 16);
+    x1 |= (x1 << 16);
+    x2 |= (x2 << 16);
+    x3 |= (x3 << 16);
+    x0 &= 0x0000FFFF0000FFFFULL;
+    x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL;
+    x3 &= 0x0000FFFF0000FFFFULL;
+    x0 |= (x0 << 8);
+    x1 |= (x1 << 8);
+    x2 |= (x2 << 8);
+    x3 |= (x3 << 8);
+    x0 &= 0x00FF00FF00FF00FFULL;
+    x1 &= 0x00FF00FF00FF00FFULL;
+    x2 &= 0x00FF00FF00FF00FFULL;
+    x3 &= 0x00FF00FF00FF00FFULL;
+    q0 = x0 | (x2 << 8);
+    q1 = x1 | (x3 << 8);
+}
+
+void InterleaveOut(uint32_t* w, uint64_t q0, uint64_t q1) {
+    uint64_t x0 = q0 & 0x00FF00FF00FF00FFULL;
+    uint64_t x1 = q1 & 0x00FF00FF00FF00FFULL;
+    uint64_t x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+    uint64_t x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+    x0 |= (x0 >> 8);
+    x1 |= (x1 >> 8);
+    x2 |= (x2 >> 8);
+    x3 |= (x3 >> 8);
+    x0 &= 0x0000FFFF0000FFFFULL;
+    x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL;
+    x3 &= 0x0000FFFF0000FFFFULL;
+    w[0] = static_cast<uint32_t>(x0) | static_cast<uint32_t>(x0 >> 16);
+    w[1] = static_cast<uint32_t>(x1) | static_cast<uint32_t>(x1 >> 16);
+    w[2] = static_cast<uint32_t>(x2) | static_cast<uint32_t>(x2 >> 16);
+    w[3] = static_cast<uint32_t>(x3) | static_cast<uint32_t>(x3 >> 16);
+}
+
+// Four blocks (64 bytes) <-> bitsliced state q[8]
+void Load4(uint64_t* q, const uint8_t* in) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; ++i) w[i] = load_le32(in + 4 * i);
+    for (int i = 0; i < 4; ++i) InterleaveIn(q[i], q[i + 4], w + 4 * i);
+    Ortho(q);
+}
+
+void Store4(uint8_t* out, uint64_t* q) {
+    uint32_t w[16];
+    Ortho(q);
+    for (int i = 0; i < 4; ++i) InterleaveOut(w + 4 * i, q[i], q[i + 4]);
+    for (int i = 0; i < 16; ++i) store_le32(out + 4 * i, w[i]);
+}
+
+inline void AddRoundKey(uint64_t* q, const uint64_t* sk) {
+    for (int i = 0; i < 8; ++i) q[i] ^= sk[i];
+}
+
+void ShiftRows(uint64_t* q) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t x = q[i];
+        q[i] = (x & 0x000000000000FFFFULL)
+             | ((x & 0x00000000FFF00000ULL) >> 4)
+             | ((x & 0x00000000000F0000ULL) << 12)
+             | ((x & 0x0000FF0000000000ULL) >> 8)
+             | ((x & 0x000000FF00000000ULL) << 8)
+             | ((x & 0xF000000000000000ULL) >> 12)
+             | ((x & 0x0FFF000000000000ULL) << 4);
+    }
+}
+
+inline uint64_t rotr32(uint64_t x) { return (x << 32) | (x >> 32); }
+
+void MixColumns(uint64_t* q) {
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    uint64_t r0 = (q0 >> 16) | (q0 << 48);
+    uint64_t r1 = (q1 >> 16) | (q1 << 48);
+    uint64_t r2 = (q2 >> 16) | (q2 << 48);
+    uint64_t r3 = (q3 >> 16) | (q3 << 48);
+    uint64_t r4 = (q4 >> 16) | (q4 << 48);
+    uint64_t r5 = (q5 >> 16) | (q5 << 48);
+    uint64_t r6 = (q6 >> 16) | (q6 << 48);
+    uint64_t r7 = (q7 >> 16) | (q7 << 48);
+
+    q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+// Both four-block groups go through each step back to back, giving the CPU
+// two independent dependency chains per round
+void Encrypt2x4(const uint64_t* skey, int rounds, uint64_t* qa, uint64_t* qb) {
+    AddRoundKey(qa, skey);
+    AddRoundKey(qb, skey);
+    for (int r = 1; r < rounds; ++r) {
+        Sbox(qa);
+        Sbox(qb);
+        ShiftRows(qa);
+        ShiftRows(qb);
+        MixColumns(qa);
+        MixColumns(qb);
+        AddRoundKey(qa, skey + 8 * r);
+        AddRoundKey(qb, skey + 8 * r);
+    }
+    Sbox(qa);
+    Sbox(qb);
+    ShiftRows(qa);
+    ShiftRows(qb);
+    AddRoundKey(qa, skey + 8 * rounds);
+    AddRoundKey(qb, skey + 8 * rounds);
+}
+
+inline uint32_t load_be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+} // namespace
+
+void Bitslice_KeySchedule(const uint8_t* roundKeys, int rounds, uint64_t* skey) {
+    // every block lane gets the same round key, so one Load4 of four copies
+    // yields the bitsliced key directly
+    uint8_t rep[64];
+    for (int r = 0; r <= rounds; ++r) {
+        for (int i = 0; i < 4; ++i) std::memcpy(rep + 16 * i, roundKeys + 16 * r, 16);
+        Load4(skey + 8 * r, rep);
+    }
+}
+
+void Bitslice_SubWord(uint8_t w[4]) {
+    uint64_t q[8] = {0};
+    q[0] = load_le32(w);
+    Ortho(q);
+    Sbox(q);
+    Ortho(q);
+    store_le32(w, static_cast<uint32_t>(q[0]));
+}
+
+void Bitslice_Encrypt8(const uint64_t* skey, int rounds, const uint8_t* in, uint8_t* out) {
+    uint64_t qa[8], qb[8];
+    Load4(qa, in);
+    Load4(qb, in + 64);
+    Encrypt2x4(skey, rounds, qa, qb);
+    Store4(out, qa);
+    Store4(out + 64, qb);
+}
+
+void Bitslice_Ctr32(const uint64_t* skey, int rounds, uint8_t counter[16],
+                    const uint8_t* in, uint8_t* out, size_t nblocks) {
+    uint8_t ks[128];
+    uint32_t c = load_be32(counter + 12);
+    while (nblocks > 0) {
+        size_t n = nblocks < 8 ? nblocks : 8;
+        // always run a full batch; unused lanes are simply discarded
+        for (size_t i = 0; i < 8; ++i) {
+            std::memcpy(ks + 16 * i, counter, 12);
+            store_be32(ks + 16 * i + 12, c + static_cast<uint32_t>(i));
+        }
+        Bitslice_Encrypt8(skey, rounds, ks, ks);
+        for (size_t i = 0; i < n * 16; ++i) out[i] = in[i] ^ ks[i];
+        c += static_cast<uint32_t>(n);
+        in += n * 16;
+        out += n * 16;
+        nblocks -= n;
+    }
+    store_be32(counter + 12, c);
+    std::memset(ks, 0, sizeof(ks));
+}
@@ -0,0 +1,28 @@
+#ifndef AES_BITSLICE_H
+#define AES_BITSLICE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Constant-time bitsliced AES (64-bit words, no table lookups, no
+// secret-dependent branches). Eight 64-bit words hold four blocks; every
+// call below works on two such groups, i.e. eight blocks at a time.
+// Layout and S-box circuit follow the BearSSL "ct64" design (Boyar-Peralta
+// S-box, 113 gates).
+
+// Bitsliced round keys: 8 words per round key, 8 * (rounds + 1) words total.
+// roundKeys is the standard FIPS-197 byte schedule.
+void Bitslice_KeySchedule(const uint8_t* roundKeys, int rounds, uint64_t* skey);
+
+// S-box applied to the four bytes of w (used for a constant-time KeyExpansion)
+void Bitslice_SubWord(uint8_t w[4]);
+
+// Encrypt 8 independent blocks (128 bytes) from in to out; in may equal out
+void Bitslice_Encrypt8(const uint64_t* skey, int rounds, const uint8_t* in, uint8_t* out);
+
+// GCM inc32 CTR over nblocks full blocks, keystream produced 8 blocks per batch.
+// Same contract as AESNI_Ctr32.
+void Bitslice_Ctr32(const uint64_t* skey, int rounds, uint8_t counter[16],
+                    const uint8_t* in, uint8_t* out, size_t nblocks);
+
+#endif
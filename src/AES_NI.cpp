@@ -0,0 +1,168 @@
+#include "AES_NI.h"
+#include "CpuFeatures.h"
+
+#if defined(AESGCM_X86)
+
+#include <immintrin.h>
+#include <cstring>
+
+#define AESNI_TARGET AESGCM_TARGET("aes,ssse3,sse4.1")
+
+namespace {
+
+// reverses all 16 bytes, so the big-endian inc32 field lands in lane 0
+AESNI_TARGET inline __m128i ByteSwapMask() {
+    return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+} // namespace
+
+AESNI_TARGET
+void AESNI_EncryptBlock(const uint8_t* roundKeys, int rounds,
+                        const uint8_t in[16], uint8_t out[16]) {
+    const __m128i* rk = reinterpret_cast<const __m128i*>(roundKeys);
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128(rk));
+    for (int r = 1; r < rounds; ++r)
+        b = _mm_aesenc_si128(b, _mm_loadu_si128(rk + r));
+    b = _mm_aesenclast_si128(b, _mm_loadu_si128(rk + rounds));
+    _mm_storeu_si128((__m128i*)out, b);
+}
+
+AESNI_TARGET
+void AESNI_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                         const uint8_t* in, uint8_t* out, size_t nblocks) {
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r);
+
+    alignas(16) uint8_t pad[128];
+    while (nblocks > 0) {
+        // a short tail still runs as one 8-block batch: same latency as one block
+        size_t n = nblocks < 8 ? nblocks : 8;
+        const __m128i* src = reinterpret_cast<const __m128i*>(in);
+        if (n < 8) {
+            std::memcpy(pad, in, n * 16);
+            src = reinterpret_cast<const __m128i*>(pad);
+        }
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(src + 0), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(src + 1), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(src + 2), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(src + 3), rk[0]);
+        __m128i b4 = _mm_xor_si128(_mm_loadu_si128(src + 4), rk[0]);
+        __m128i b5 = _mm_xor_si128(_mm_loadu_si128(src + 5), rk[0]);
+        __m128i b6 = _mm_xor_si128(_mm_loadu_si128(src + 6), rk[0]);
+        __m128i b7 = _mm_xor_si128(_mm_loadu_si128(src + 7), rk[0]);
+        for (int r = 1; r < rounds; ++r) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+            b4 = _mm_aesenc_si128(b4, rk[r]);
+            b5 = _mm_aesenc_si128(b5, rk[r]);
+            b6 = _mm_aesenc_si128(b6, rk[r]);
+            b7 = _mm_aesenc_si128(b7, rk[r]);
+        }
+        __m128i* dst = reinterpret_cast<__m128i*>(n < 8 ? pad : out);
+        _mm_storeu_si128(dst + 0, _mm_aesenclast_si128(b0, rk[rounds]));
+        _mm_storeu_si128(dst + 1, _mm_aesenclast_si128(b1, rk[rounds]));
+        _mm_storeu_si128(dst + 2, _mm_aesenclast_si128(b2, rk[rounds]));
+        _mm_storeu_si128(dst + 3, _mm_aesenclast_si128(b3, rk[rounds]));
+        _mm_storeu_si128(dst + 4, _mm_aesenclast_si128(b4, rk[rounds]));
+        _mm_storeu_si128(dst + 5, _mm_aesenclast_si128(b5, rk[rounds]));
+        _mm_storeu_si128(dst + 6, _mm_aesenclast_si128(b6, rk[rounds]));
+        _mm_storeu_si128(dst + 7, _mm_aesenclast_si128(b7, rk[rounds]));
+        if (n < 8) std::memcpy(out, pad, n * 16);
+        in += n * 16;
+        out += n * 16;
+        nblocks -= n;
+    }
+}
+
+AESNI_TARGET
+void AESNI_Ctr32(const uint8_t* roundKeys, int rounds, uint8_t counter[16],
+                 const uint8_t* in, uint8_t* out, size_t nblocks) {
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r);
+
+    const __m128i bswap = ByteSwapMask();
+    // counter kept byte-reversed: adding to lane 0 is inc32 modulo 2^32
+    __m128i ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)counter), bswap);
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+    const __m128i eight = _mm_set_epi32(0, 0, 0, 8);
+
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    while (nblocks >= 8) {
+        __m128i c1 = _mm_add_epi32(ctr, one);
+        __m128i c2 = _mm_add_epi32(c1, one);
+        __m128i c3 = _mm_add_epi32(c2, one);
+        __m128i c4 = _mm_add_epi32(c3, one);
+        __m128i c5 = _mm_add_epi32(c4, one);
+        __m128i c6 = _mm_add_epi32(c5, one);
+        __m128i c7 = _mm_add_epi32(c6, one);
+        __m128i b0 = _mm_xor_si128(_mm_shuffle_epi8(ctr, bswap), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_shuffle_epi8(c1, bswap), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_shuffle_epi8(c2, bswap), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_shuffle_epi8(c3, bswap), rk[0]);
+        __m128i b4 = _mm_xor_si128(_mm_shuffle_epi8(c4, bswap), rk[0]);
+        __m128i b5 = _mm_xor_si128(_mm_shuffle_epi8(c5, bswap), rk[0]);
+        __m128i b6 = _mm_xor_si128(_mm_shuffle_epi8(c6, bswap), rk[0]);
+        __m128i b7 = _mm_xor_si128(_mm_shuffle_epi8(c7, bswap), rk[0]);
+        ctr = _mm_add_epi32(ctr, eight);
+
+        // eight independent AESENC chains hide the per-instruction latency
+        for (int r = 1; r < rounds; ++r) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+            b4 = _mm_aesenc_si128(b4, rk[r]);
+            b5 = _mm_aesenc_si128(b5, rk[r]);
+            b6 = _mm_aesenc_si128(b6, rk[r]);
+            b7 = _mm_aesenc_si128(b7, rk[r]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[rounds]);
+        b1 = _mm_aesenclast_si128(b1, rk[rounds]);
+        b2 = _mm_aesenclast_si128(b2, rk[rounds]);
+        b3 = _mm_aesenclast_si128(b3, rk[rounds]);
+        b4 = _mm_aesenclast_si128(b4, rk[rounds]);
+        b5 = _mm_aesenclast_si128(b5, rk[rounds]);
+        b6 = _mm_aesenclast_si128(b6, rk[rounds]);
+        b7 = _mm_aesenclast_si128(b7, rk[rounds]);
+
+        _mm_storeu_si128(dst + 0, _mm_xor_si128(b0, _mm_loadu_si128(src + 0)));
+        _mm_storeu_si128(dst + 1, _mm_xor_si128(b1, _mm_loadu_si128(src + 1)));
+        _mm_storeu_si128(dst + 2, _mm_xor_si128(b2, _mm_loadu_si128(src + 2)));
+        _mm_storeu_si128(dst + 3, _mm_xor_si128(b3, _mm_loadu_si128(src + 3)));
+        _mm_storeu_si128(dst + 4, _mm_xor_si128(b4, _mm_loadu_si128(src + 4)));
+        _mm_storeu_si128(dst + 5, _mm_xor_si128(b5, _mm_loadu_si128(src + 5)));
+        _mm_storeu_si128(dst + 6, _mm_xor_si128(b6, _mm_loadu_si128(src + 6)));
+        _mm_storeu_si128(dst + 7, _mm_xor_si128(b7, _mm_loadu_si128(src + 7)));
+        src += 8;
+        dst += 8;
+        nblocks -= 8;
+    }
+
+    while (nblocks > 0) {
+        __m128i b = _mm_xor_si128(_mm_shuffle_epi8(ctr, bswap), rk[0]);
+        ctr = _mm_add_epi32(ctr, one);
+        for (int r = 1; r < rounds; ++r) b = _mm_aesenc_si128(b, rk[r]);
+        b = _mm_aesenclast_si128(b, rk[rounds]);
+        _mm_storeu_si128(dst, _mm_xor_si128(b, _mm_loadu_si128(src)));
+        ++src;
+        ++dst;
+        --nblocks;
+    }
+
+    _mm_storeu_si128((__m128i*)counter, _mm_shuffle_epi8(ctr, bswap));
+}
+
+#else // !AESGCM_X86
+
+void AESNI_EncryptBlock(const uint8_t*, int, const uint8_t[16], uint8_t[16]) {}
+void AESNI_EncryptBlocks(const uint8_t*, int, const uint8_t*, uint8_t*, size_t) {}
+void AESNI_Ctr32(const uint8_t*, int, uint8_t[16], const uint8_t*, uint8_t*, size_t) {}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef AES_NI_H
+#define AES_NI_H
+
+#include <cstddef>
+#include <cstdint>
+
+// x86 AES-NI kernels. roundKeys is the standard FIPS-197 byte schedule
+// (16 * (rounds + 1) bytes), exactly as produced by AES<KeyBits>::KeyExpansion.
+// Callers must check GetCpuFeatures().aesni before calling; on non-x86
+// builds these are never selected.
+
+void AESNI_EncryptBlock(const uint8_t* roundKeys, int rounds,
+                        const uint8_t in[16], uint8_t out[16]);
+
+// ECB over nblocks independent blocks (in may equal out), 8 in flight; a
+// partial final group is padded to a full batch. Used to encrypt counter
+// blocks gathered from several messages at once.
+void AESNI_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                         const uint8_t* in, uint8_t* out, size_t nblocks);
+
+// CTR with a 32-bit big-endian counter in bytes 12..15 (GCM inc32).
+// out[i] = in[i] ^ E(counter + i) for nblocks full blocks; counter is
+// advanced past the last block used. Keeps 8 blocks in flight per round.
+void AESNI_Ctr32(const uint8_t* roundKeys, int rounds, uint8_t counter[16],
+                 const uint8_t* in, uint8_t* out, size_t nblocks);
+
+#endif
@@ -0,0 +1,166 @@
+#include "BufferPool.h"
+#include "Instrument.h"
+#include "SecureZero.h"
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+BufferPool::Buffer::Buffer(Buffer&& o) noexcept
+    : pool(std::exchange(o.pool, nullptr)), data(std::exchange(o.data, nullptr)),
+      size(std::exchange(o.size, 0)), cls(o.cls) {}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& o) noexcept {
+    if (this != &o) {
+        Release();
+        pool = std::exchange(o.pool, nullptr);
+        data = std::exchange(o.data, nullptr);
+        size = std::exchange(o.size, 0);
+        cls = o.cls;
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::Release() {
+    if (data) pool->Put(data, size, cls);
+    pool = nullptr;
+    data = nullptr;
+    size = 0;
+}
+
+BufferPool::BufferPool(const Options& o) : opt(o) {}
+
+BufferPool::~BufferPool() {
+    Trim();
+}
+
+BufferPool& BufferPool::Shared() {
+    static BufferPool pool;
+    return pool;
+}
+
+unsigned BufferPool::ClassOf(size_t n) {
+    unsigned cls = 0;
+    while (ClassBytes(cls) < n) ++cls;
+    return cls;
+}
+
+uint8_t* BufferPool::AllocateBlock(unsigned cls) {
+    const size_t bytes = ClassBytes(cls);
+    void* p = nullptr;
+#ifdef _WIN32
+    p = _aligned_malloc(bytes, bytes >= 4096 ? 4096 : Alignment);
+    if (!p) throw std::bad_alloc();
+    bool locked = !opt.lock || VirtualLock(p, bytes);
+#else
+    if (bytes >= LargeBytes) {
+        // own mapping: page aligned, huge-page capable, unmapped on free
+        p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (opt.explicitHuge) p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (p == MAP_FAILED) {
+            p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+            if (opt.transparentHuge || opt.explicitHuge) ::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+        }
+    } else if (::posix_memalign(&p, bytes >= 4096 ? 4096 : Alignment, bytes) != 0) {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_DONTDUMP
+    // keep secrets out of core dumps as well
+    if (opt.lock && bytes >= LargeBytes) ::madvise(p, bytes, MADV_DONTDUMP);
+#endif
+    bool locked = !opt.lock || ::mlock(p, bytes) == 0;
+#endif
+    AESGCM_ALLOC(bytes);
+    std::lock_guard<std::mutex> lk(m);
+    ++fresh;
+    if (!locked) ++lockFailures;
+    return static_cast<uint8_t*>(p);
+}
+
+void BufferPool::FreeBlock(uint8_t* p, unsigned cls) {
+    const size_t bytes = ClassBytes(cls);
+#ifdef _WIN32
+    if (opt.lock) VirtualUnlock(p, bytes);
+    _aligned_free(p);
+#else
+    if (opt.lock) ::munlock(p, bytes);
+    if (bytes >= LargeBytes) ::munmap(p, bytes);
+    else std::free(p);
+#endif
+}
+
+BufferPool::Buffer BufferPool::Acquire(size_t n) {
+    Buffer b;
+    if (n == 0) return b;
+    if (n > MaxBytes) throw std::length_error("buffer pool request exceeds 2 GiB");
+    unsigned cls = ClassOf(n);
+    uint8_t* p = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (!freeList[cls].empty()) {
+            p = freeList[cls].back();
+            freeList[cls].pop_back();
+            cached -= ClassBytes(cls);
+        }
+    }
+    if (!p) p = AllocateBlock(cls);
+    b.pool = this;
+    b.data = p;
+    b.size = n;
+    b.cls = cls;
+    return b;
+}
+
+void BufferPool::Put(uint8_t* p, size_t used, unsigned cls) {
+    // only the bytes handed out can hold data: the rest of the block was
+    // never exposed, or was wiped when an earlier, larger use released it
+    if (opt.zeroize) SecureZero(p, used);
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (cached + ClassBytes(cls) <= opt.maxCachedBytes) {
+            freeList[cls].push_back(p);
+            cached += ClassBytes(cls);
+            return;
+        }
+    }
+    FreeBlock(p, cls);
+}
+
+void BufferPool::Trim() {
+    std::vector<uint8_t*> drop[kClasses];
+    {
+        std::lock_guard<std::mutex> lk(m);
+        for (unsigned c = 0; c < kClasses; ++c) drop[c].swap(freeList[c]);
+        cached = 0;
+    }
+    for (unsigned c = 0; c < kClasses; ++c)
+        for (uint8_t* p : drop[c]) FreeBlock(p, c);
+}
+
+size_t BufferPool::CachedBytes() const {
+    std::lock_guard<std::mutex> lk(m);
+    return cached;
+}
+
+uint64_t BufferPool::FreshBlocks() const {
+    std::lock_guard<std::mutex> lk(m);
+    return fresh;
+}
+
+uint64_t BufferPool::LockFailures() const {
+    std::lock_guard<std::mutex> lk(m);
+    return lockFailures;
+}
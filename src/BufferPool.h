@@ -0,0 +1,103 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Reusable aligned buffers for the crypto engine and the file paths.
+// Requests are rounded up to a power-of-two size class (64 B .. 2 GiB); a
+// released buffer goes back to its class and the next request of that class
+// takes it without touching the heap, so a steady stream of same-sized
+// messages allocates nothing after warm-up.
+//
+// Every buffer is 64-byte aligned (one cache line, full AVX-512 vector);
+// buffers of 4 KiB and up are page aligned, which also suits O_DIRECT.
+// Classes from LargeBytes up are separate mmaps on Linux and can be backed
+// by huge pages; the mapping is committed lazily, so the rounding up to the
+// class size costs address space, not memory (unless lock pins it). With zeroize the bytes handed out are wiped on release,
+// with lock every block is mlock'ed (VirtualLock on Windows) so secrets are
+// never written to swap.
+struct BufferPoolOptions {
+    bool zeroize = true;            // wipe on release (keys, plaintext)
+    bool lock = false;              // mlock / VirtualLock, best effort (RLIMIT_MEMLOCK)
+    bool transparentHuge = false;   // Linux: MADV_HUGEPAGE on large blocks
+    bool explicitHuge = false;      // Linux: MAP_HUGETLB on large blocks, falls back if none reserved
+    size_t maxCachedBytes = size_t(256) << 20; // free blocks kept beyond this are returned to the OS
+};
+
+class BufferPool {
+public:
+    using Options = BufferPoolOptions;
+
+    static constexpr size_t Alignment = 64;
+    static constexpr size_t LargeBytes = size_t(2) << 20; // one x86 huge page
+    static constexpr size_t MaxBytes = size_t(1) << 31;
+
+    // Move-only handle; returns its block to the pool when destroyed. Must
+    // not outlive the pool.
+    class Buffer {
+    public:
+        Buffer() = default;
+        ~Buffer() { Release(); }
+        Buffer(Buffer&& o) noexcept;
+        Buffer& operator=(Buffer&& o) noexcept;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+        bool Empty() const { return data == nullptr; }
+        // Hands the block back early (zeroized per the pool's options)
+        void Release();
+
+    private:
+        friend class BufferPool;
+        BufferPool* pool = nullptr;
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        unsigned cls = 0;
+    };
+
+    explicit BufferPool(const Options& opt = Options());
+    ~BufferPool(); // frees every cached block; outstanding Buffers must be gone
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // n bytes (n may be 0: an empty handle). Contents are unspecified unless
+    // the pool zeroizes (then a reused block reads as zeros). Throws
+    // std::length_error above MaxBytes, std::bad_alloc if the OS refuses.
+    Buffer Acquire(size_t n);
+
+    // Returns every cached block to the OS
+    void Trim();
+
+    const Options& GetOptions() const { return opt; }
+    size_t CachedBytes() const;
+    // Blocks obtained from the OS so far (stays flat in steady state)
+    uint64_t FreshBlocks() const;
+    // Blocks that could not be locked (lock = true and RLIMIT_MEMLOCK reached)
+    uint64_t LockFailures() const;
+
+    // Process-wide pool with default options (zeroize, no lock)
+    static BufferPool& Shared();
+
+private:
+    static constexpr unsigned kClasses = 26; // 64 B << 0 .. 64 B << 25 = 2 GiB
+
+    Options opt;
+    mutable std::mutex m;
+    std::vector<uint8_t*> freeList[kClasses];
+    size_t cached = 0;
+    uint64_t fresh = 0;
+    uint64_t lockFailures = 0;
+
+    static unsigned ClassOf(size_t n);
+    static size_t ClassBytes(unsigned cls) { return Alignment << cls; }
+    uint8_t* AllocateBlock(unsigned cls);
+    void FreeBlock(uint8_t* p, unsigned cls);
+    void Put(uint8_t* p, size_t used, unsigned cls);
+};
+
+#endif
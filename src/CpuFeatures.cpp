@@ -0,0 +1,72 @@
+#include "CpuFeatures.h"
+
+#if defined(AESGCM_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+#if defined(AESGCM_X86)
+void cpuid(unsigned leaf, unsigned sub, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int)leaf, (int)sub);
+    for (int i = 0; i < 4; ++i) regs[i] = (unsigned)r[i];
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0: which register states the OS saves on context switch
+unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (unsigned long long)hi << 32 | lo;
+#endif
+}
+#endif
+
+CpuFeatures Detect() {
+    CpuFeatures f;
+#if defined(AESGCM_X86)
+    unsigned r[4] = {0, 0, 0, 0};
+    cpuid(0, 0, r);
+    unsigned maxLeaf = r[0];
+    if (maxLeaf < 1) return f;
+
+    cpuid(1, 0, r);
+    unsigned ecx = r[2];
+    f.pclmul = (ecx >> 1) & 1;
+    f.ssse3 = (ecx >> 9) & 1;
+    f.sse41 = (ecx >> 19) & 1;
+    f.aesni = (ecx >> 25) & 1;
+    f.sse2 = (r[3] >> 26) & 1;
+    bool osYmm = ((ecx >> 27) & 1) && (xgetbv0() & 6) == 6; // OSXSAVE, XMM + YMM state
+
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, r);
+        f.avx2 = osYmm && ((r[1] >> 5) & 1);
+        f.sha = (r[1] >> 29) & 1;
+        // XCR0 bits 5..7: opmask, upper halves of ZMM0-15, ZMM16-31
+        bool osZmm = osYmm && (xgetbv0() & 0xe0) == 0xe0;
+        f.avx512 = osZmm && ((r[1] >> 16) & 1) && ((r[1] >> 30) & 1) && ((r[1] >> 31) & 1);
+        f.vaes = osYmm && ((r[2] >> 9) & 1);
+        f.vpclmul = osYmm && ((r[2] >> 10) & 1);
+    }
+#endif
+    return f;
+}
+
+} // namespace
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = Detect();
+    return features;
+}
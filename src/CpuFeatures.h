@@ -0,0 +1,42 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Runtime CPU feature detection used to pick hardware backends.
+// Kernels that need ISA extensions are compiled with per-function target
+// attributes, so the rest of the project builds with the default flags.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AESGCM_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AESGCM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define AESGCM_TARGET(isa)
+#endif
+
+// Forces inlining where GCC's heuristics give up (unrolled rounds, lane
+// kernels that must be inlined into their AESGCM_TARGET wrapper)
+#if defined(__GNUC__) || defined(__clang__)
+#define AESGCM_INLINE inline __attribute__((always_inline))
+#else
+#define AESGCM_INLINE inline
+#endif
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool aesni = false;
+    bool pclmul = false;
+    bool sha = false;  // SHA-NI (SHA-1/SHA-256 extensions)
+    bool avx2 = false; // CPU support and YMM state enabled by the OS
+    bool avx512 = false; // AVX-512 F + BW + VL, ZMM and mask state enabled by the OS
+    bool vaes = false;    // VAES: AESENC on YMM/ZMM (needs avx2 or avx512 to use)
+    bool vpclmul = false; // VPCLMULQDQ on YMM/ZMM
+};
+
+// Detected once (CPUID on x86, all false elsewhere) and cached.
+const CpuFeatures& GetCpuFeatures();
+
+#endif
@@ -1,25 +1,92 @@
 #include "GCM.h"
+#include "CpuFeatures.h"
+#include "GCM_CLMUL.h"
+#include "GCM_VAES.h"
+#include "Instrument.h"
+#include "SecureZero.h"
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
 
-// Helper: XOR two 16-byte vectors
-void AES256_GCM::XOR(std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
-    for (size_t i = 0; i < 16; ++i) a[i] ^= b[i];
-}
+template <class Cipher>
+AES_GCM<Cipher>::AES_GCM(const std::vector<uint8_t>& key)
+    : AES_GCM(key, Cipher::DefaultBackend()) {}
 
-AES256_GCM::AES256_GCM(const std::vector<uint8_t>& key)
-    : aes(key)
+template <class Cipher>
+AES_GCM<Cipher>::AES_GCM(const std::vector<uint8_t>& key, AesBackend aesBackend)
+    : aes(key, aesBackend)
 {
+    AESGCM_PHASE(GcmPhase::GhashKeySetup, 0, 1, 0);
     // compute H = AES_K(0^128)
-    H.assign(16, 0);
-    aes.EncryptBlock(H.data());
+    aes.EncryptBlock(H);
     PrecomputeHTable();
+    PrecomputeHPowers();
+    if (GhashBackendSupported(GhashBackend::Clmul)) ghashBackend = GhashBackend::Clmul;
+    else if (aesBackend == AesBackend::Bitsliced) ghashBackend = GhashBackend::ConstantTime;
+    else ghashBackend = GhashBackend::Table4;
+    simdTier = DefaultSimdTier();
+}
+
+template <class Cipher>
+AES_GCM<Cipher>::~AES_GCM() {
+    SecureZero(H, sizeof(H));
+    SecureZero(Htable.data(), sizeof(Htable));
+    SecureZero(HL, sizeof(HL));
+    SecureZero(HH, sizeof(HH));
+    SecureZero(Hpow, sizeof(Hpow));
+}
+
+template <class Cipher>
+bool AES_GCM<Cipher>::GhashBackendSupported(GhashBackend b) {
+    switch (b) {
+    case GhashBackend::Bitwise:
+    case GhashBackend::Table4:
+    case GhashBackend::ConstantTime: return true;
+    case GhashBackend::Clmul: {
+        const CpuFeatures& cpu = GetCpuFeatures();
+        return cpu.pclmul && cpu.ssse3 && cpu.sse41;
+    }
+    }
+    return false;
 }
 
-void AES256_GCM::PrecomputeHTable() {
+template <class Cipher>
+void AES_GCM<Cipher>::SetGhashBackend(GhashBackend b) {
+    if (!GhashBackendSupported(b)) throw std::invalid_argument("GHASH backend not supported on this CPU");
+    ghashBackend = b;
+}
+
+template <class Cipher>
+bool AES_GCM<Cipher>::SimdTierSupported(SimdTier t) {
+    const CpuFeatures& cpu = GetCpuFeatures();
+    // the wide kernels hand their tail to the 128-bit ones
+    bool base = cpu.aesni && cpu.pclmul && cpu.ssse3 && cpu.sse41;
+    switch (t) {
+    case SimdTier::Sse: return true;
+    case SimdTier::Avx2: return base && cpu.avx2 && cpu.vaes && cpu.vpclmul;
+    case SimdTier::Avx512: return base && cpu.avx512 && cpu.vaes && cpu.vpclmul;
+    }
+    return false;
+}
+
+template <class Cipher>
+GcmSimdTier AES_GCM<Cipher>::DefaultSimdTier() {
+    if (SimdTierSupported(SimdTier::Avx512)) return SimdTier::Avx512;
+    if (SimdTierSupported(SimdTier::Avx2)) return SimdTier::Avx2;
+    return SimdTier::Sse;
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::SetSimdTier(SimdTier t) {
+    if (!SimdTierSupported(t)) throw std::invalid_argument("SIMD tier not supported on this CPU");
+    simdTier = t;
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::PrecomputeHTable() {
     std::array<uint8_t, 16> v{};
-    std::copy(H.begin(), H.end(), v.begin());
+    std::copy(H, H + 16, v.begin());
     for (int i = 0; i < 128; ++i) {
         Htable[i] = v;
         uint8_t lsb = v[15] & 1;
@@ -27,168 +94,813 @@ void AES256_GCM::PrecomputeHTable() {
             v[j] = static_cast<uint8_t>((v[j] >> 1) | ((v[j - 1] & 1) << 7));
         }
         v[0] = static_cast<uint8_t>(v[0] >> 1);
-        if (lsb) v[0] ^= 0xe1;
+        v[0] ^= static_cast<uint8_t>(0xe1 & -lsb); // masked: H is secret
+    }
+
+    // Shoup 4-bit tables. Index bits are reflected like GHASH itself: nibble
+    // 8 is H, 4 is H*x, 2 is H*x^2, 1 is H*x^3; the rest are XOR combinations.
+    uint64_t vh = 0, vl = 0;
+    for (int i = 0; i < 8; ++i) vh = (vh << 8) | H[i];
+    for (int i = 8; i < 16; ++i) vl = (vl << 8) | H[i];
+    HL[0] = 0; HH[0] = 0;
+    HL[8] = vl; HH[8] = vh;
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t T = (vl & 1) * 0xe100000000000000ULL;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ T;
+        HL[i] = vl; HH[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+        for (int j = 1; j < i; ++j) {
+            HH[i + j] = HH[i] ^ HH[j];
+            HL[i + j] = HL[i] ^ HL[j];
+        }
+    }
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::PrecomputeHPowers() {
+    std::memcpy(Hpow[0], H, 16);
+    for (int i = 1; i < 16; ++i) GaloisMultiply(Hpow[i - 1], H, Hpow[i]);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::MulH(uint8_t X[16]) const {
+    uint8_t Z[16] = {0};
+    for (int i = 0; i < 128; ++i) {
+        uint8_t mask = static_cast<uint8_t>(-((X[i / 8] >> (7 - (i % 8))) & 1));
+        for (int j = 0; j < 16; ++j) Z[j] ^= Htable[i][j] & mask;
+    }
+    std::memcpy(X, Z, 16);
+}
+
+// Reduction of the four bits shifted out of Z per nibble step, pre-multiplied
+// by the GHASH polynomial (0xe1 reflected) and placed in the top 16 bits
+static const uint16_t kLast4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+// Processes X from its last byte to its first, low nibble then high nibble:
+// Z = (Z >> 4) ^ reduce(shifted-out bits) ^ M[nibble], 32 table steps per block
+template <class Cipher>
+void AES_GCM<Cipher>::MulH4Bit(uint8_t X[16]) const {
+    uint8_t lo = X[15] & 0x0f;
+    uint64_t zh = HH[lo];
+    uint64_t zl = HL[lo];
+    for (int i = 15; i >= 0; --i) {
+        lo = X[i] & 0x0f;
+        uint8_t hi = (X[i] >> 4) & 0x0f;
+        uint8_t rem;
+        if (i != 15) {
+            rem = static_cast<uint8_t>(zl & 0x0f);
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (uint64_t(kLast4[rem]) << 48);
+            zh ^= HH[lo];
+            zl ^= HL[lo];
+        }
+        rem = static_cast<uint8_t>(zl & 0x0f);
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (uint64_t(kLast4[rem]) << 48);
+        zh ^= HH[hi];
+        zl ^= HL[hi];
+    }
+    for (int i = 0; i < 8; ++i) {
+        X[i] = static_cast<uint8_t>(zh >> (56 - 8 * i));
+        X[8 + i] = static_cast<uint8_t>(zl >> (56 - 8 * i));
+    }
+}
+
+// Constant-time GF(2^128) multiply (BearSSL "ctmul64" technique): 64x64
+// carry-less products emulated with integer multiplies on bit-strided masks,
+// so holes between the sampled bits absorb the carries.
+static inline uint64_t bmul64(uint64_t x, uint64_t y) {
+    const uint64_t m0 = 0x1111111111111111ULL, m1 = 0x2222222222222222ULL;
+    const uint64_t m2 = 0x4444444444444444ULL, m3 = 0x8888888888888888ULL;
+    uint64_t x0 = x & m0, x1 = x & m1, x2 = x & m2, x3 = x & m3;
+    uint64_t y0 = y & m0, y1 = y & m1, y2 = y & m2, y3 = y & m3;
+    uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+    return (z0 & m0) | (z1 & m1) | (z2 & m2) | (z3 & m3);
+}
+
+static inline uint64_t rev64(uint64_t x) {
+    x = ((x & 0x5555555555555555ULL) << 1) | ((x >> 1) & 0x5555555555555555ULL);
+    x = ((x & 0x3333333333333333ULL) << 2) | ((x >> 2) & 0x3333333333333333ULL);
+    x = ((x & 0x0F0F0F0F0F0F0F0FULL) << 4) | ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+    x = ((x & 0x00FF00FF00FF00FFULL) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+    x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+    return (x << 32) | (x >> 32);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::MulHCt(uint8_t X[16]) const {
+    uint64_t h1 = 0, h0 = 0, y1 = 0, y0 = 0;
+    for (int i = 0; i < 8; ++i) {
+        h1 = (h1 << 8) | H[i];
+        h0 = (h0 << 8) | H[8 + i];
+        y1 = (y1 << 8) | X[i];
+        y0 = (y0 << 8) | X[8 + i];
+    }
+    uint64_t h0r = rev64(h0), h1r = rev64(h1);
+    uint64_t h2 = h0 ^ h1, h2r = h0r ^ h1r;
+    uint64_t y0r = rev64(y0), y1r = rev64(y1);
+    uint64_t y2 = y0 ^ y1, y2r = y0r ^ y1r;
+
+    // Karatsuba on the low halves and, bit-reversed, on the high halves
+    uint64_t z0 = bmul64(y0, h0);
+    uint64_t z1 = bmul64(y1, h1);
+    uint64_t z2 = bmul64(y2, h2);
+    uint64_t z0h = bmul64(y0r, h0r);
+    uint64_t z1h = bmul64(y1r, h1r);
+    uint64_t z2h = bmul64(y2r, h2r);
+    z2 ^= z0 ^ z1;
+    z2h ^= z0h ^ z1h;
+    z0h = rev64(z0h) >> 1;
+    z1h = rev64(z1h) >> 1;
+    z2h = rev64(z2h) >> 1;
+
+    uint64_t v0 = z0, v1 = z0h ^ z2, v2 = z1 ^ z2h, v3 = z1h;
+    v3 = (v3 << 1) | (v2 >> 63);
+    v2 = (v2 << 1) | (v1 >> 63);
+    v1 = (v1 << 1) | (v0 >> 63);
+    v0 = (v0 << 1);
+
+    // reduce modulo x^128 + x^7 + x^2 + x + 1 (bit-reflected)
+    v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+    v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+    v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+    v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+    for (int i = 0; i < 8; ++i) {
+        X[i] = static_cast<uint8_t>(v3 >> (56 - 8 * i));
+        X[8 + i] = static_cast<uint8_t>(v2 >> (56 - 8 * i));
+    }
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::GhashBlocks(uint8_t X[16], const uint8_t* data, size_t nblocks) const {
+    AESGCM_PHASE(GcmPhase::Ghash, nblocks * 16, nblocks, nblocks);
+    if (ghashBackend == GhashBackend::Clmul) {
+        if (simdTier == SimdTier::Avx512) VPCLMUL512_GhashBlocks(Hpow, X, data, nblocks);
+        else if (simdTier == SimdTier::Avx2) VPCLMUL256_GhashBlocks(Hpow, X, data, nblocks);
+        else CLMUL_GhashBlocks(Hpow, X, data, nblocks);
+        return;
+    }
+    if (ghashBackend == GhashBackend::Table4) {
+        for (size_t i = 0; i < nblocks; ++i) {
+            for (int j = 0; j < 16; ++j) X[j] ^= data[i * 16 + j];
+            MulH4Bit(X);
+        }
+        return;
+    }
+    if (ghashBackend == GhashBackend::ConstantTime) {
+        for (size_t i = 0; i < nblocks; ++i) {
+            for (int j = 0; j < 16; ++j) X[j] ^= data[i * 16 + j];
+            MulHCt(X);
+        }
+        return;
+    }
+    for (size_t i = 0; i < nblocks; ++i) {
+        for (int j = 0; j < 16; ++j) X[j] ^= data[i * 16 + j];
+        MulH(X);
     }
 }
 
 // increment rightmost 32 bits (bytes 12..15) as big-endian counter
-void AES256_GCM::Inc32(std::vector<uint8_t>& counter) const {
+template <class Cipher>
+void AES_GCM<Cipher>::Inc32(uint8_t counter[16]) {
     for (int i = 15; i >= 12; --i) {
         if (++counter[i]) break;
     }
 }
 
+template <class Cipher>
+void AES_GCM<Cipher>::AddCounter(uint8_t counter[16], uint32_t n) {
+    uint32_t c = (uint32_t(counter[12]) << 24) | (uint32_t(counter[13]) << 16) |
+                 (uint32_t(counter[14]) << 8) | uint32_t(counter[15]);
+    c += n;
+    counter[12] = static_cast<uint8_t>(c >> 24);
+    counter[13] = static_cast<uint8_t>(c >> 16);
+    counter[14] = static_cast<uint8_t>(c >> 8);
+    counter[15] = static_cast<uint8_t>(c);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::MakeJ0(const uint8_t* iv, size_t ivLen, uint8_t J0[16]) {
+    if (ivLen != 12) {
+        throw std::invalid_argument("Only 12-byte IV supported in this simple implementation");
+    }
+    std::memcpy(J0, iv, 12);
+    J0[12] = 0;
+    J0[13] = 0;
+    J0[14] = 0;
+    J0[15] = 1;
+}
+
 // GCTR: AES-CTR using block encryption in-place (counter is 16 bytes).
 // We follow convention: caller provides icb (J0). We encrypt counter+1, counter+2, ...
-std::vector<uint8_t> AES256_GCM::GCTR(const std::vector<uint8_t>& icb,
+// The keystream loop lives in AES<KeyBits>::EncryptCtr32 so hardware backends can
+// keep several counter blocks in flight.
+template <class Cipher>
+void AES_GCM<Cipher>::GCTR(const uint8_t icb[16], const uint8_t* in, uint8_t* out, size_t len) const {
+    AESGCM_PHASE(GcmPhase::Gctr, len, (len + 15) / 16, 0);
+    uint8_t counter[16];
+    std::memcpy(counter, icb, 16);
+    Inc32(counter); // increment before use -> first keystream block is J0+1
+    aes.EncryptCtr32(counter, in, out, len);
+}
+
+template <class Cipher>
+std::vector<uint8_t> AES_GCM<Cipher>::GCTR(const std::vector<uint8_t>& icb,
                                       const std::vector<uint8_t>& input) const {
     if (icb.size() != 16) throw std::invalid_argument("icb must be 16 bytes");
+    AESGCM_ALLOC(input.size());
     std::vector<uint8_t> output(input.size());
-    std::vector<uint8_t> counter = icb;
-    std::vector<uint8_t> block(16);
-
-    size_t n = (input.size() + 15) / 16;
-    for (size_t i = 0; i < n; ++i) {
-        Inc32(counter); // increment before use -> first keystream block is J0+1
-        std::memcpy(block.data(), counter.data(), 16);
-        aes.EncryptBlock(block.data()); // block now keystream
-        size_t offset = i * 16;
-        size_t len = std::min<size_t>(16, input.size() - offset);
-        for (size_t j = 0; j < len; ++j)
-            output[offset + j] = input[offset + j] ^ block[j];
-    }
+    GCTR(icb.data(), input.data(), output.data(), input.size());
     return output;
 }
 
 // Multiply X and Y in GF(2^128) (X and Y are 16-byte big-endian bitstrings)
-// Implementation: bitwise algorithm (shift-and-xor) with reduction polynomial 0xe1
-std::vector<uint8_t> AES256_GCM::GaloisMultiply(
-    const std::vector<uint8_t>& X,
-    const std::vector<uint8_t>& Y) const
-{
-    // Fast path: GHASH always multiplies by H, so reuse precomputed shifts
-    if (Y == H) {
-        std::array<uint8_t, 16> Z{};
-        for (int i = 0; i < 128; ++i) {
-            int bit = (X[i / 8] >> (7 - (i % 8))) & 1;
-            if (bit) {
-                for (int j = 0; j < 16; ++j) Z[j] ^= Htable[i][j];
-            }
-        }
-        return std::vector<uint8_t>(Z.begin(), Z.end());
-    }
-
-    // Fallback generic multiply
-    std::vector<uint8_t> Z(16, 0);
-    std::vector<uint8_t> V = Y; // copy
+// Implementation: bitwise algorithm (shift-and-xor) with reduction polynomial 0xe1.
+// Only used for setup (powers of H); GHASH itself goes through GhashBlocks.
+template <class Cipher>
+void AES_GCM<Cipher>::GaloisMultiply(const uint8_t X[16], const uint8_t Y[16], uint8_t Zout[16]) {
+    AESGCM_PHASE(GcmPhase::GaloisMultiply, 0, 0, 1);
+    uint8_t Z[16] = {0};
+    uint8_t V[16];
+    std::memcpy(V, Y, 16);
     for (int i = 0; i < 128; ++i) {
-        int bit = (X[i / 8] >> (7 - (i % 8))) & 1;
-        if (bit) {
-            for (int j = 0; j < 16; ++j) Z[j] ^= V[j];
-        }
+        uint8_t mask = static_cast<uint8_t>(-((X[i / 8] >> (7 - (i % 8))) & 1));
+        for (int j = 0; j < 16; ++j) Z[j] ^= V[j] & mask;
         uint8_t lsb = V[15] & 1;
         for (int j = 15; j > 0; --j) {
-            V[j] = (V[j] >> 1) | ((V[j - 1] & 1) << 7);
+            V[j] = static_cast<uint8_t>((V[j] >> 1) | ((V[j - 1] & 1) << 7));
         }
         V[0] >>= 1;
-        if (lsb) V[0] ^= 0xe1;
+        V[0] ^= static_cast<uint8_t>(0xe1 & -lsb);
+    }
+    std::memcpy(Zout, Z, 16);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::GhashPadded(uint8_t X[16], const uint8_t* data, size_t len) const {
+    size_t full = len / 16;
+    GhashBlocks(X, data, full);
+    size_t rem = len % 16;
+    if (rem) {
+        uint8_t block[16] = {0}; // zero-pad the final partial block
+        std::memcpy(block, data + full * 16, rem);
+        GhashBlocks(X, block, 1);
+    }
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::GhashLengths(uint8_t X[16], uint64_t aadLen, uint64_t cLen) const {
+    // 64-bit AAD length || 64-bit ciphertext length (both in bits), big-endian
+    uint8_t lenBlock[16];
+    uint64_t aadBits = aadLen * 8;
+    uint64_t cBits = cLen * 8;
+    for (int i = 0; i < 8; ++i) lenBlock[7 - i] = static_cast<uint8_t>(aadBits >> (i * 8));
+    for (int i = 0; i < 8; ++i) lenBlock[15 - i] = static_cast<uint8_t>(cBits >> (i * 8));
+    GhashBlocks(X, lenBlock, 1);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::CryptAndHash(bool decrypt, uint8_t counter[16], uint8_t X[16],
+                              const uint8_t* in, uint8_t* out, size_t len) const {
+    AESGCM_PHASE(GcmPhase::CryptAndHash, len, (len + 15) / 16, (len + 15) / 16);
+    size_t full = len / 16;
+    if (aes.GetBackend() == AesBackend::AESNI && ghashBackend == GhashBackend::Clmul) {
+        // fully stitched kernel: AESENC and PCLMULQDQ interleaved per round
+        const uint8_t* rk = aes.roundKeys.data();
+        if (simdTier == SimdTier::Avx512) {
+            if (decrypt) VAES512_GcmDecrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+            else VAES512_GcmEncrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+        } else if (simdTier == SimdTier::Avx2) {
+            if (decrypt) VAES256_GcmDecrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+            else VAES256_GcmEncrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+        } else {
+            if (decrypt) CLMUL_AESNI_GcmDecrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+            else CLMUL_AESNI_GcmEncrypt(rk, Cipher::Nr, Hpow, counter, X, in, out, full);
+        }
+    } else {
+        // chunk small enough that GHASH re-reads it from L1
+        const size_t chunkBlocks = 256; // 4 KiB
+        for (size_t done = 0; done < full; done += chunkBlocks) {
+            size_t n = std::min(chunkBlocks, full - done);
+            const uint8_t* src = in + done * 16;
+            uint8_t* dst = out + done * 16;
+            if (decrypt) {
+                GhashBlocks(X, src, n);
+                aes.EncryptCtr32(counter, src, dst, n * 16);
+            } else {
+                aes.EncryptCtr32(counter, src, dst, n * 16);
+                GhashBlocks(X, dst, n);
+            }
+        }
+    }
+    size_t rem = len % 16;
+    if (rem) {
+        uint8_t block[16] = {0};
+        const uint8_t* src = in + full * 16;
+        uint8_t* dst = out + full * 16;
+        if (decrypt) {
+            std::memcpy(block, src, rem);
+            aes.EncryptCtr32(counter, src, dst, rem);
+        } else {
+            aes.EncryptCtr32(counter, src, dst, rem);
+            std::memcpy(block, dst, rem);
+        }
+        GhashBlocks(X, block, 1);
     }
-    return Z;
 }
 
 // GHASH: process AAD then ciphertext, returning 16-byte tag S
-std::vector<uint8_t> AES256_GCM::GHASH(
+template <class Cipher>
+void AES_GCM<Cipher>::GHASH(const uint8_t* aad, size_t aadLen,
+                       const uint8_t* ciphertext, size_t cLen, uint8_t S[16]) const {
+    std::memset(S, 0, 16);
+    GhashPadded(S, aad, aadLen);
+    GhashPadded(S, ciphertext, cLen);
+    GhashLengths(S, aadLen, cLen);
+}
+
+template <class Cipher>
+std::vector<uint8_t> AES_GCM<Cipher>::GHASH(
     const std::vector<uint8_t>& aad,
     const std::vector<uint8_t>& ciphertext) const
 {
-    std::vector<uint8_t> X(16, 0);
-    auto process = [&](const std::vector<uint8_t>& data) {
-        for (size_t i = 0; i < data.size(); i += 16) {
-            std::vector<uint8_t> block(16, 0);
-            size_t len = std::min<size_t>(16, data.size() - i);
-            std::memcpy(block.data(), data.data() + i, len);
-            XOR(X, block);
-            X = GaloisMultiply(X, H);
-        }
-    };
-    if (!aad.empty()) process(aad);
-    if (!ciphertext.empty()) process(ciphertext);
-
-    // process lengths: 64-bit AAD length || 64-bit ciphertext length (both in bits) per spec
-    std::vector<uint8_t> lenBlock(16, 0);
-    uint64_t aadBits = (uint64_t)aad.size() * 8;
-    uint64_t cBits = (uint64_t)ciphertext.size() * 8;
-    // store as big-endian 64-bit || 64-bit
-    for (int i = 0; i < 8; ++i) lenBlock[7 - i] = static_cast<uint8_t>(aadBits >> (i * 8));
-    for (int i = 0; i < 8; ++i) lenBlock[15 - i] = static_cast<uint8_t>(cBits >> (i * 8));
-    XOR(X, lenBlock);
-    X = GaloisMultiply(X, H);
-
+    AESGCM_ALLOC(16);
+    std::vector<uint8_t> X(16);
+    GHASH(aad.data(), aad.size(), ciphertext.data(), ciphertext.size(), X.data());
     return X;
 }
 
 // Encrypt: produce ciphertext and tag_out (16 bytes)
-std::vector<uint8_t> AES256_GCM::Encrypt(
+template <class Cipher>
+void AES_GCM<Cipher>::Encrypt(const uint8_t* iv, size_t ivLen,
+                         const uint8_t* plaintext, size_t len,
+                         const uint8_t* aad, size_t aadLen,
+                         uint8_t* ciphertext, uint8_t tag_out[16]) const
+{
+    uint8_t J0[16];
+    MakeJ0(iv, ivLen, J0);
+    if (len > MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    // single pass: CTR from J0+1, GHASH over aad then each ciphertext chunk
+    uint8_t counter[16];
+    std::memcpy(counter, J0, 16);
+    Inc32(counter);
+    uint8_t S[16] = {0};
+    GhashPadded(S, aad, aadLen);
+    CryptAndHash(false, counter, S, plaintext, ciphertext, len);
+    GhashLengths(S, aadLen, len);
+
+    // Tag = AES_K(J0) xor S
+    aes.EncryptBlock(J0);
+    for (int i = 0; i < 16; ++i) tag_out[i] = J0[i] ^ S[i];
+}
+
+template <class Cipher>
+std::vector<uint8_t> AES_GCM<Cipher>::Encrypt(
     const std::vector<uint8_t>& iv,
     const std::vector<uint8_t>& plaintext,
     const std::vector<uint8_t>& aad,
-    std::vector<uint8_t>& tag_out)
+    std::vector<uint8_t>& tag_out) const
 {
-    // J0 = IV || 0x00000001 for 96-bit IV (12 bytes)
-    if (iv.size() != 12) {
-        throw std::invalid_argument("Only 12-byte IV supported in this simple implementation");
-    }
-    std::vector<uint8_t> J0(16, 0);
-    std::memcpy(J0.data(), iv.data(), 12);
-    J0[15] = 1;
+    AESGCM_ALLOC(plaintext.size());
+    std::vector<uint8_t> ciphertext(plaintext.size());
+    tag_out.resize(16);
+    Encrypt(iv.data(), iv.size(), plaintext.data(), plaintext.size(),
+            aad.data(), aad.size(), ciphertext.data(), tag_out.data());
+    return ciphertext;
+}
 
-    // CTR encrypt (GCTR) -> ciphertext
-    std::vector<uint8_t> ciphertext = GCTR(J0, plaintext);
+// Decrypt: writes plaintext if tag verifies, otherwise wipes it and throws
+template <class Cipher>
+void AES_GCM<Cipher>::Decrypt(const uint8_t* iv, size_t ivLen,
+                         const uint8_t* ciphertext, size_t len,
+                         const uint8_t* aad, size_t aadLen,
+                         const uint8_t tag[16], uint8_t* plaintext) const
+{
+    uint8_t J0[16];
+    MakeJ0(iv, ivLen, J0);
+    if (len > MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
 
-    // GHASH over aad and ciphertext
-    std::vector<uint8_t> S = GHASH(aad, ciphertext);
+    // single pass: hash each ciphertext chunk, then decrypt it
+    uint8_t counter[16];
+    std::memcpy(counter, J0, 16);
+    Inc32(counter);
+    uint8_t S[16] = {0};
+    GhashPadded(S, aad, aadLen);
+    CryptAndHash(true, counter, S, ciphertext, plaintext, len);
+    GhashLengths(S, aadLen, len);
 
-    // Tag = AES_K(J0) xor S
-    std::vector<uint8_t> EkJ0(16);
-    std::memcpy(EkJ0.data(), J0.data(), 16);
-    aes.EncryptBlock(EkJ0.data());
-    tag_out.resize(16);
-    for (int i = 0; i < 16; ++i) tag_out[i] = EkJ0[i] ^ S[i];
+    aes.EncryptBlock(J0);
 
-    return ciphertext;
+    // constant-time compare
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>((J0[i] ^ S[i]) ^ tag[i]);
+    if (diff != 0) {
+        // plaintext was produced in the same pass; never release it unverified
+        if (len) std::memset(plaintext, 0, len);
+        throw std::runtime_error("GCM authentication failed!");
+    }
 }
 
-// Decrypt: returns plaintext if tag verifies, otherwise throws
-std::vector<uint8_t> AES256_GCM::Decrypt(
+template <class Cipher>
+std::vector<uint8_t> AES_GCM<Cipher>::Decrypt(
     const std::vector<uint8_t>& iv,
     const std::vector<uint8_t>& ciphertext,
     const std::vector<uint8_t>& aad,
-    const std::vector<uint8_t>& tag)
+    const std::vector<uint8_t>& tag) const
 {
-    if (iv.size() != 12) {
-        throw std::invalid_argument("Only 12-byte IV supported in this simple implementation");
-    }
     if (tag.size() != 16) {
         throw std::invalid_argument("GCM tag must be 16 bytes");
     }
-    std::vector<uint8_t> J0(16, 0);
-    std::memcpy(J0.data(), iv.data(), 12);
-    J0[15] = 1;
+    AESGCM_ALLOC(ciphertext.size());
+    std::vector<uint8_t> plaintext(ciphertext.size());
+    Decrypt(iv.data(), iv.size(), ciphertext.data(), ciphertext.size(),
+            aad.data(), aad.size(), tag.data(), plaintext.data());
+    return plaintext;
+}
+
+template <class Cipher>
+BufferPool::Buffer AES_GCM<Cipher>::Encrypt(const uint8_t* iv, size_t ivLen,
+                                            const uint8_t* plaintext, size_t len,
+                                            const uint8_t* aad, size_t aadLen,
+                                            uint8_t tag_out[16], BufferPool& pool) const
+{
+    BufferPool::Buffer ciphertext = pool.Acquire(len);
+    Encrypt(iv, ivLen, plaintext, len, aad, aadLen, ciphertext.Data(), tag_out);
+    return ciphertext;
+}
 
-    // compute tag
-    std::vector<uint8_t> S = GHASH(aad, ciphertext);
-    std::vector<uint8_t> EkJ0(16);
-    std::memcpy(EkJ0.data(), J0.data(), 16);
-    aes.EncryptBlock(EkJ0.data());
-    std::vector<uint8_t> tag_verify(16);
-    for (int i = 0; i < 16; ++i) tag_verify[i] = EkJ0[i] ^ S[i];
+template <class Cipher>
+BufferPool::Buffer AES_GCM<Cipher>::Decrypt(const uint8_t* iv, size_t ivLen,
+                                            const uint8_t* ciphertext, size_t len,
+                                            const uint8_t* aad, size_t aadLen,
+                                            const uint8_t tag[16], BufferPool& pool) const
+{
+    BufferPool::Buffer plaintext = pool.Acquire(len);
+    Decrypt(iv, ivLen, ciphertext, len, aad, aadLen, tag, plaintext.Data());
+    return plaintext;
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::HPower(uint64_t e, uint8_t Z[16]) const {
+    uint8_t base[16];
+    std::memcpy(base, H, 16);
+    bool first = true;
+    for (;;) {
+        if (e & 1) {
+            if (first) std::memcpy(Z, base, 16);
+            else GaloisMultiply(Z, base, Z);
+            first = false;
+        }
+        e >>= 1;
+        if (!e) break;
+        GaloisMultiply(base, base, base);
+    }
+}
+
+// Horner over segments: with Y_i the GHASH of segment i started from zero and
+// b_i its block count, X' = X * H^b_i ^ Y_i, which is the serial result.
+template <class Cipher>
+void AES_GCM<Cipher>::ParallelCryptAndHash(bool decrypt, const uint8_t counter[16], uint8_t X[16],
+                                      const uint8_t* in, uint8_t* out, size_t len,
+                                      ThreadPool& pool) const {
+    size_t blocks = (len + 15) / 16;
+    size_t nseg = std::min({pool.Concurrency(), len / ParallelMinBytes, ParallelMaxSegments});
+    if (nseg < 2) {
+        uint8_t ctr[16];
+        std::memcpy(ctr, counter, 16);
+        CryptAndHash(decrypt, ctr, X, in, out, len);
+        return;
+    }
+    size_t segBlocks = (blocks + nseg - 1) / nseg;
+    nseg = (blocks + segBlocks - 1) / segBlocks;
+
+    // partials on the stack and the body passed by reference: std::function
+    // would heap-allocate a copy of a capture this large
+    uint8_t partial[ParallelMaxSegments][16];
+    auto body = [&](size_t i) {
+        size_t first = i * segBlocks;
+        size_t off = first * 16;
+        size_t n = std::min(segBlocks * 16, len - off);
+        uint8_t ctr[16];
+        std::memcpy(ctr, counter, 16);
+        AddCounter(ctr, static_cast<uint32_t>(first)); // len <= MaxMessageBytes, no overflow
+        uint8_t* Y = partial[i];
+        std::memset(Y, 0, 16);
+        CryptAndHash(decrypt, ctr, Y, in + off, out + off, n);
+    };
+    pool.ParallelFor(nseg, std::ref(body));
+    FoldPartials(X, partial, nseg, segBlocks, blocks - (nseg - 1) * segBlocks);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::ParallelGhashBlocks(uint8_t X[16], const uint8_t* data, size_t nblocks,
+                                     ThreadPool& pool) const {
+    size_t nseg = std::min({pool.Concurrency(), nblocks / (ParallelMinBytes / 16), ParallelMaxSegments});
+    if (nseg < 2) {
+        GhashBlocks(X, data, nblocks);
+        return;
+    }
+    size_t segBlocks = (nblocks + nseg - 1) / nseg;
+    nseg = (nblocks + segBlocks - 1) / segBlocks;
+
+    uint8_t partial[ParallelMaxSegments][16];
+    auto body = [&](size_t i) {
+        size_t first = i * segBlocks;
+        uint8_t* Y = partial[i];
+        std::memset(Y, 0, 16);
+        GhashBlocks(Y, data + first * 16, std::min(segBlocks, nblocks - first));
+    };
+    pool.ParallelFor(nseg, std::ref(body));
+    FoldPartials(X, partial, nseg, segBlocks, nblocks - (nseg - 1) * segBlocks);
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::FoldPartials(uint8_t X[16], const uint8_t (*partial)[16], size_t nseg,
+                              size_t segBlocks, size_t lastBlocks) const {
+    uint8_t Hseg[16], Hlast[16];
+    HPower(segBlocks, Hseg);
+    HPower(lastBlocks, Hlast);
+    for (size_t i = 0; i < nseg; ++i) {
+        GaloisMultiply(X, i + 1 < nseg ? Hseg : Hlast, X);
+        for (int j = 0; j < 16; ++j) X[j] ^= partial[i][j];
+    }
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::EncryptParallel(const uint8_t* iv, size_t ivLen,
+                                 const uint8_t* plaintext, size_t len,
+                                 const uint8_t* aad, size_t aadLen,
+                                 uint8_t* ciphertext, uint8_t tag_out[16],
+                                 ThreadPool& pool) const
+{
+    uint8_t J0[16];
+    MakeJ0(iv, ivLen, J0);
+    if (len > MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    uint8_t counter[16];
+    std::memcpy(counter, J0, 16);
+    Inc32(counter);
+    uint8_t S[16] = {0};
+    GhashPadded(S, aad, aadLen);
+    ParallelCryptAndHash(false, counter, S, plaintext, ciphertext, len, pool);
+    GhashLengths(S, aadLen, len);
+
+    aes.EncryptBlock(J0);
+    for (int i = 0; i < 16; ++i) tag_out[i] = J0[i] ^ S[i];
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::DecryptParallel(const uint8_t* iv, size_t ivLen,
+                                 const uint8_t* ciphertext, size_t len,
+                                 const uint8_t* aad, size_t aadLen,
+                                 const uint8_t tag[16], uint8_t* plaintext,
+                                 ThreadPool& pool) const
+{
+    uint8_t J0[16];
+    MakeJ0(iv, ivLen, J0);
+    if (len > MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    uint8_t counter[16];
+    std::memcpy(counter, J0, 16);
+    Inc32(counter);
+    uint8_t S[16] = {0};
+    GhashPadded(S, aad, aadLen);
+    ParallelCryptAndHash(true, counter, S, ciphertext, plaintext, len, pool);
+    GhashLengths(S, aadLen, len);
+
+    aes.EncryptBlock(J0);
 
-    // constant-time compare
     uint8_t diff = 0;
-    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>(tag_verify[i] ^ tag[i]);
-    if (diff != 0) throw std::runtime_error("GCM authentication failed!");
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>((J0[i] ^ S[i]) ^ tag[i]);
+    if (diff != 0) {
+        if (len) std::memset(plaintext, 0, len);
+        throw std::runtime_error("GCM authentication failed!");
+    }
+}
 
-    // recover plaintext only after tag passes
-    std::vector<uint8_t> plaintext = GCTR(J0, ciphertext);
-    return plaintext;
+template <class Cipher>
+bool AES_GCM<Cipher>::VerifyTag(const uint8_t* iv, size_t ivLen, const uint8_t* ciphertext, size_t len,
+                                const uint8_t* aad, size_t aadLen, const uint8_t tag[16],
+                                ThreadPool* pool) const
+{
+    uint8_t J0[16];
+    MakeJ0(iv, ivLen, J0);
+    if (len > MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    // S = GHASH(A || pad || C || pad || lengths); the counter stream is never generated
+    uint8_t S[16] = {0};
+    GhashPadded(S, aad, aadLen);
+    size_t full = len / 16;
+    if (pool) ParallelGhashBlocks(S, ciphertext, full, *pool);
+    else GhashBlocks(S, ciphertext, full);
+    GhashPadded(S, ciphertext + full * 16, len % 16);
+    GhashLengths(S, aadLen, len);
+
+    aes.EncryptBlock(J0);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>((J0[i] ^ S[i]) ^ tag[i]);
+    SecureZero(S, sizeof(S));
+    return diff == 0;
+}
+
+template <class Cipher>
+bool AES_GCM<Cipher>::Verify(const uint8_t* iv, size_t ivLen,
+                             const uint8_t* ciphertext, size_t len,
+                             const uint8_t* aad, size_t aadLen,
+                             const uint8_t tag[16]) const
+{
+    return VerifyTag(iv, ivLen, ciphertext, len, aad, aadLen, tag, nullptr);
+}
+
+template <class Cipher>
+bool AES_GCM<Cipher>::Verify(const std::vector<uint8_t>& iv,
+                             const std::vector<uint8_t>& ciphertext,
+                             const std::vector<uint8_t>& aad,
+                             const std::vector<uint8_t>& tag) const
+{
+    if (tag.size() != 16) throw std::invalid_argument("GCM tag must be 16 bytes");
+    return VerifyTag(iv.data(), iv.size(), ciphertext.data(), ciphertext.size(),
+                     aad.data(), aad.size(), tag.data(), nullptr);
+}
+
+template <class Cipher>
+bool AES_GCM<Cipher>::VerifyParallel(const uint8_t* iv, size_t ivLen,
+                                     const uint8_t* ciphertext, size_t len,
+                                     const uint8_t* aad, size_t aadLen,
+                                     const uint8_t tag[16], ThreadPool& pool) const
+{
+    return VerifyTag(iv, ivLen, ciphertext, len, aad, aadLen, tag, &pool);
+}
+
+namespace {
+// Per-group scratch limits for the batch API (kept on the stack)
+const size_t kBatchRecords = 16;        // GHASH streams per group
+const size_t kBatchAesBlocks = 320;     // J0 + counter blocks per group (5 KiB)
+const size_t kBatchHashBlocks = 640;    // padded AAD || C || lengths per group (10 KiB)
+// (16 records of BatchMaxRecordBytes data and AAD fit both)
+
+size_t Blocks(size_t len) { return (len + 15) / 16; }
+
+void XorBytes(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        x ^= y;
+        std::memcpy(out + i, &x, 8);
+    }
+    for (; i < n; ++i) out[i] = a[i] ^ b[i];
+}
+}
+
+template <class Cipher>
+size_t AES_GCM<Cipher>::CryptBatchGroup(bool decrypt, const BatchItem* items, size_t n, bool* ok) const {
+    if (n == 0) return 0;
+    alignas(16) uint8_t ctr[kBatchAesBlocks * 16];
+    alignas(16) uint8_t ks[kBatchAesBlocks * 16];
+    alignas(16) uint8_t hashIn[kBatchHashBlocks * 16];
+    const uint8_t* hashPtr[kBatchRecords];
+    size_t hashBlocks[kBatchRecords];
+    uint8_t S[kBatchRecords][16];
+    size_t ksOff[kBatchRecords];
+
+    // J0 = IV || 1, J0+1, ... of every record, then one pipelined AES run over all of them
+    size_t nb = 0;
+    for (size_t i = 0; i < n; ++i) {
+        ksOff[i] = nb;
+        uint8_t* c = ctr + nb * 16;
+        size_t k = Blocks(items[i].len);
+        for (size_t j = 0; j <= k; ++j, c += 16) {
+            uint32_t v = static_cast<uint32_t>(j + 1);
+            std::memcpy(c, items[i].iv, 12);
+            c[12] = static_cast<uint8_t>(v >> 24);
+            c[13] = static_cast<uint8_t>(v >> 16);
+            c[14] = static_cast<uint8_t>(v >> 8);
+            c[15] = static_cast<uint8_t>(v);
+        }
+        nb += 1 + k;
+    }
+    const bool wideAes = aes.GetBackend() == AesBackend::AESNI && simdTier != SimdTier::Sse;
+    if (wideAes && simdTier == SimdTier::Avx512) VAES512_EncryptBlocks(aes.roundKeys.data(), Cipher::Nr, ctr, ks, nb);
+    else if (wideAes) VAES256_EncryptBlocks(aes.roundKeys.data(), Cipher::Nr, ctr, ks, nb);
+    else aes.EncryptBlocks(ctr, ks, nb);
+
+    // GHASH input per record: AAD || pad || C || pad || len(A) || len(C)
+    auto xorKeystream = [&](size_t i) {
+        XorBytes(items[i].out, items[i].in, ks + (ksOff[i] + 1) * 16, items[i].len);
+    };
+    size_t hb = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const BatchItem& it = items[i];
+        if (!decrypt) xorKeystream(i);
+        const uint8_t* ct = decrypt ? it.in : it.out;
+        uint8_t* h = hashIn + hb * 16;
+        size_t a = Blocks(it.aadLen) * 16, c = Blocks(it.len) * 16;
+        // only the padding of each partial block needs zeroing
+        if (a) std::memset(h + a - 16, 0, 16);
+        if (c) std::memset(h + a + c - 16, 0, 16);
+        if (it.aadLen) std::memcpy(h, it.aad, it.aadLen);
+        if (it.len) std::memcpy(h + a, ct, it.len);
+        uint64_t abits = uint64_t(it.aadLen) * 8, cbits = uint64_t(it.len) * 8;
+        for (int j = 0; j < 8; ++j) {
+            h[a + c + j] = static_cast<uint8_t>(abits >> (56 - 8 * j));
+            h[a + c + 8 + j] = static_cast<uint8_t>(cbits >> (56 - 8 * j));
+        }
+        hashPtr[i] = h;
+        hashBlocks[i] = (a + c) / 16 + 1;
+        hb += hashBlocks[i];
+        std::memset(S[i], 0, 16);
+    }
+    if (ghashBackend == GhashBackend::Clmul) {
+        if (simdTier == SimdTier::Avx512) VPCLMUL512_GhashMulti(Hpow, n, hashPtr, hashBlocks, S);
+        else if (simdTier == SimdTier::Avx2) VPCLMUL256_GhashMulti(Hpow, n, hashPtr, hashBlocks, S);
+        else CLMUL_GhashMulti(Hpow, n, hashPtr, hashBlocks, S);
+    } else {
+        for (size_t i = 0; i < n; ++i) GhashBlocks(S[i], hashPtr[i], hashBlocks[i]);
+    }
+
+    size_t failures = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t* ekj0 = ks + ksOff[i] * 16;
+        if (!decrypt) {
+            XorBytes(items[i].tag, ekj0, S[i], 16);
+            continue;
+        }
+        uint8_t diff = 0;
+        for (int j = 0; j < 16; ++j) diff |= static_cast<uint8_t>((ekj0[j] ^ S[i][j]) ^ items[i].tag[j]);
+        // tag is checked before any plaintext is written
+        if (diff == 0) {
+            xorKeystream(i);
+        } else {
+            if (items[i].len) std::memset(items[i].out, 0, items[i].len);
+            ++failures;
+        }
+        if (ok) ok[i] = diff == 0;
+    }
+    return failures;
+}
+
+template <class Cipher>
+size_t AES_GCM<Cipher>::CryptBatch(bool decrypt, const BatchItem* items, size_t n, bool* ok) const {
+    size_t failures = 0;
+    size_t i = 0;
+    while (i < n) {
+        const BatchItem& it = items[i];
+        if (it.len > BatchMaxRecordBytes || it.aadLen > BatchMaxRecordBytes) {
+            // big enough to keep the pipeline full on its own
+            if (!decrypt) {
+                Encrypt(it.iv, 12, it.in, it.len, it.aad, it.aadLen, it.out, it.tag);
+            } else {
+                bool good = true;
+                try {
+                    Decrypt(it.iv, 12, it.in, it.len, it.aad, it.aadLen, it.tag, it.out);
+                } catch (const std::runtime_error&) {
+                    good = false;
+                    ++failures;
+                }
+                if (ok) ok[i] = good;
+            }
+            ++i;
+            continue;
+        }
+        // grow the group while it fits the scratch buffers
+        size_t j = i, aesBlocks = 0, hashBlocks = 0;
+        while (j < n && j - i < kBatchRecords) {
+            const BatchItem& r = items[j];
+            if (r.len > BatchMaxRecordBytes || r.aadLen > BatchMaxRecordBytes) break;
+            size_t ab = 1 + Blocks(r.len), hbk = Blocks(r.aadLen) + Blocks(r.len) + 1;
+            if (aesBlocks + ab > kBatchAesBlocks || hashBlocks + hbk > kBatchHashBlocks) break;
+            aesBlocks += ab;
+            hashBlocks += hbk;
+            ++j;
+        }
+        failures += CryptBatchGroup(decrypt, items + i, j - i, ok ? ok + i : nullptr);
+        i = j;
+    }
+    return failures;
+}
+
+template <class Cipher>
+void AES_GCM<Cipher>::EncryptBatch(const BatchItem* items, size_t n) const {
+    CryptBatch(false, items, n, nullptr);
 }
+
+template <class Cipher>
+size_t AES_GCM<Cipher>::DecryptBatch(const BatchItem* items, size_t n, bool* ok) const {
+    return CryptBatch(true, items, n, ok);
+}
+
+template class AES_GCM<AES128>;
+template class AES_GCM<AES192>;
+template class AES_GCM<AES256>;
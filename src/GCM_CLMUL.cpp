@@ -0,0 +1,355 @@
+#include "GCM_CLMUL.h"
+#include "CpuFeatures.h"
+
+#if defined(AESGCM_X86)
+
+#include <immintrin.h>
+
+#define CLMUL_TARGET AESGCM_TARGET("pclmul,ssse3,sse4.1")
+
+namespace {
+
+// GHASH bit order is reflected; reversing the bytes lets PCLMULQDQ work on
+// the value as an ordinary polynomial (Intel carry-less multiplication guide)
+CLMUL_TARGET inline __m128i ByteSwapMask() {
+    return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+// 128x128 -> 256-bit carry-less product accumulated into lo/mid/hi
+CLMUL_TARGET inline void MulAcc(__m128i a, __m128i b, __m128i& lo, __m128i& mid, __m128i& hi) {
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+}
+
+// Fold mid into lo/hi, shift the 256-bit product left by one (bit reflection)
+// and reduce modulo x^128 + x^7 + x^2 + x + 1.
+CLMUL_TARGET inline __m128i Reduce(__m128i lo, __m128i mid, __m128i hi) {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    __m128i t4 = _mm_srli_epi32(lo, 2);
+    __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+// Absorb r (1..8) blocks with one reduction: (x ^ B1)*H^r ^ B2*H^(r-1) ^ ... ^ Br*H
+CLMUL_TARGET inline __m128i GhashChunk(__m128i x, const __m128i* p, size_t r,
+                                       const __m128i* h, __m128i bswap) {
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    MulAcc(_mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(p), bswap)), h[r - 1], lo, mid, hi);
+    for (size_t j = 1; j < r; ++j)
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + j), bswap), h[r - 1 - j], lo, mid, hi);
+    return Reduce(lo, mid, hi);
+}
+
+} // namespace
+
+CLMUL_TARGET
+void CLMUL_GhashBlocks(const uint8_t Hpow[8][16], uint8_t X[16],
+                       const uint8_t* data, size_t nblocks) {
+    const __m128i bswap = ByteSwapMask();
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Hpow[i]), bswap);
+
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), bswap);
+    const __m128i* p = reinterpret_cast<const __m128i*>(data);
+
+    while (nblocks >= 8) {
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        MulAcc(_mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(p + 0), bswap)), h[7], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 1), bswap), h[6], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 2), bswap), h[5], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 3), bswap), h[4], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 4), bswap), h[3], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 5), bswap), h[2], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 6), bswap), h[1], lo, mid, hi);
+        MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(p + 7), bswap), h[0], lo, mid, hi);
+        x = Reduce(lo, mid, hi);
+        p += 8;
+        nblocks -= 8;
+    }
+    if (nblocks > 0) x = GhashChunk(x, p, nblocks, h, bswap);
+
+    _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, bswap));
+}
+
+CLMUL_TARGET
+void CLMUL_GhashMulti(const uint8_t Hpow[8][16], size_t streams,
+                      const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]) {
+    const __m128i bswap = ByteSwapMask();
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Hpow[i]), bswap);
+
+    for (size_t base = 0; base < streams; base += 4) {
+        size_t m = streams - base < 4 ? streams - base : 4;
+        __m128i x[4];
+        const __m128i* p[4];
+        size_t left[4];
+        for (size_t s = 0; s < m; ++s) {
+            x[s] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X[base + s]), bswap);
+            p[s] = reinterpret_cast<const __m128i*>(data[base + s]);
+            left[s] = nblocks[base + s];
+        }
+        // round-robin over the streams: their multiply/reduce chains are
+        // independent, so the CPU overlaps them
+        for (bool more = true; more;) {
+            more = false;
+            for (size_t s = 0; s < m; ++s) {
+                if (!left[s]) continue;
+                size_t r = left[s] < 8 ? left[s] : 8;
+                x[s] = GhashChunk(x[s], p[s], r, h, bswap);
+                p[s] += r;
+                left[s] -= r;
+                more |= left[s] != 0;
+            }
+        }
+        for (size_t s = 0; s < m; ++s)
+            _mm_storeu_si128((__m128i*)X[base + s], _mm_shuffle_epi8(x[s], bswap));
+    }
+}
+
+#define STITCH_TARGET AESGCM_TARGET("aes,pclmul,ssse3,sse4.1")
+
+namespace {
+
+STITCH_TARGET inline void LoadRoundKeys(const uint8_t* roundKeys, int rounds, __m128i* rk) {
+    for (int r = 0; r <= rounds; ++r)
+        rk[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r);
+}
+
+} // namespace
+
+// Eight named registers (not an array) so the compiler keeps the whole batch
+// in XMM registers across the round loop
+#define STITCH_COUNTERS()                                                  \
+    __m128i b0 = _mm_xor_si128(_mm_shuffle_epi8(ctr, bswap), rk[0]);       \
+    __m128i b1 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 1)), bswap), rk[0]); \
+    __m128i b2 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 2)), bswap), rk[0]); \
+    __m128i b3 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 3)), bswap), rk[0]); \
+    __m128i b4 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 4)), bswap), rk[0]); \
+    __m128i b5 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 5)), bswap), rk[0]); \
+    __m128i b6 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 6)), bswap), rk[0]); \
+    __m128i b7 = _mm_xor_si128(_mm_shuffle_epi8(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 7)), bswap), rk[0]); \
+    ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 8))
+
+#define STITCH_AESENC(k)                                                   \
+    b0 = _mm_aesenc_si128(b0, k); b1 = _mm_aesenc_si128(b1, k);            \
+    b2 = _mm_aesenc_si128(b2, k); b3 = _mm_aesenc_si128(b3, k);            \
+    b4 = _mm_aesenc_si128(b4, k); b5 = _mm_aesenc_si128(b5, k);            \
+    b6 = _mm_aesenc_si128(b6, k); b7 = _mm_aesenc_si128(b7, k)
+
+#define STITCH_AESENCLAST(k)                                               \
+    b0 = _mm_aesenclast_si128(b0, k); b1 = _mm_aesenclast_si128(b1, k);    \
+    b2 = _mm_aesenclast_si128(b2, k); b3 = _mm_aesenclast_si128(b3, k);    \
+    b4 = _mm_aesenclast_si128(b4, k); b5 = _mm_aesenclast_si128(b5, k);    \
+    b6 = _mm_aesenclast_si128(b6, k); b7 = _mm_aesenclast_si128(b7, k)
+
+// Rounds 1..8 each carry one GHASH multiply (c0..c7, already byte-swapped,
+// c0 with the running X folded in); the remaining rounds are plain AES
+#define STITCH_ROUNDS_WITH_GHASH(c0, c1, c2, c3, c4, c5, c6, c7)           \
+    STITCH_AESENC(rk[1]); MulAcc(c0, h[7], lo, mid, hi);                   \
+    STITCH_AESENC(rk[2]); MulAcc(c1, h[6], lo, mid, hi);                   \
+    STITCH_AESENC(rk[3]); MulAcc(c2, h[5], lo, mid, hi);                   \
+    STITCH_AESENC(rk[4]); MulAcc(c3, h[4], lo, mid, hi);                   \
+    STITCH_AESENC(rk[5]); MulAcc(c4, h[3], lo, mid, hi);                   \
+    STITCH_AESENC(rk[6]); MulAcc(c5, h[2], lo, mid, hi);                   \
+    STITCH_AESENC(rk[7]); MulAcc(c6, h[1], lo, mid, hi);                   \
+    STITCH_AESENC(rk[8]); MulAcc(c7, h[0], lo, mid, hi);                   \
+    for (int r = 9; r < rounds; ++r) { STITCH_AESENC(rk[r]); }             \
+    STITCH_AESENCLAST(rk[rounds])
+
+// Keystream for the last 1..7 blocks: one full 8-block batch costs about the
+// same latency as a single block, so short messages do not go block by block
+STITCH_TARGET inline void TailKeystream(__m128i ctr, const __m128i* rk, int rounds,
+                                        __m128i bswap, __m128i* ks) {
+    STITCH_COUNTERS();
+    for (int r = 1; r < rounds; ++r) { STITCH_AESENC(rk[r]); }
+    STITCH_AESENCLAST(rk[rounds]);
+    ks[0] = b0; ks[1] = b1; ks[2] = b2; ks[3] = b3;
+    ks[4] = b4; ks[5] = b5; ks[6] = b6; ks[7] = b7;
+}
+
+STITCH_TARGET
+void CLMUL_AESNI_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[8][16],
+                            uint8_t counter[16], uint8_t X[16],
+                            const uint8_t* in, uint8_t* out, size_t nblocks) {
+    __m128i rk[15];
+    LoadRoundKeys(roundKeys, rounds, rk);
+    const __m128i bswap = ByteSwapMask();
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Hpow[i]), bswap);
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), bswap);
+    __m128i ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)counter), bswap);
+
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    if (nblocks >= 8) {
+        // first batch has no previous ciphertext to hash
+        STITCH_COUNTERS();
+        for (int r = 1; r < rounds; ++r) { STITCH_AESENC(rk[r]); }
+        STITCH_AESENCLAST(rk[rounds]);
+        _mm_storeu_si128(dst + 0, _mm_xor_si128(b0, _mm_loadu_si128(src + 0)));
+        _mm_storeu_si128(dst + 1, _mm_xor_si128(b1, _mm_loadu_si128(src + 1)));
+        _mm_storeu_si128(dst + 2, _mm_xor_si128(b2, _mm_loadu_si128(src + 2)));
+        _mm_storeu_si128(dst + 3, _mm_xor_si128(b3, _mm_loadu_si128(src + 3)));
+        _mm_storeu_si128(dst + 4, _mm_xor_si128(b4, _mm_loadu_si128(src + 4)));
+        _mm_storeu_si128(dst + 5, _mm_xor_si128(b5, _mm_loadu_si128(src + 5)));
+        _mm_storeu_si128(dst + 6, _mm_xor_si128(b6, _mm_loadu_si128(src + 6)));
+        _mm_storeu_si128(dst + 7, _mm_xor_si128(b7, _mm_loadu_si128(src + 7)));
+        src += 8;
+        dst += 8;
+        nblocks -= 8;
+
+        // steady state: AES of batch i interleaved with GHASH of batch i-1
+        while (nblocks >= 8) {
+            const __m128i* prev = dst - 8;
+            __m128i c0 = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(prev + 0), bswap));
+            __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 1), bswap);
+            __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 2), bswap);
+            __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 3), bswap);
+            __m128i c4 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 4), bswap);
+            __m128i c5 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 5), bswap);
+            __m128i c6 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 6), bswap);
+            __m128i c7 = _mm_shuffle_epi8(_mm_loadu_si128(prev + 7), bswap);
+            __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+            STITCH_COUNTERS();
+            STITCH_ROUNDS_WITH_GHASH(c0, c1, c2, c3, c4, c5, c6, c7);
+            _mm_storeu_si128(dst + 0, _mm_xor_si128(b0, _mm_loadu_si128(src + 0)));
+            _mm_storeu_si128(dst + 1, _mm_xor_si128(b1, _mm_loadu_si128(src + 1)));
+            _mm_storeu_si128(dst + 2, _mm_xor_si128(b2, _mm_loadu_si128(src + 2)));
+            _mm_storeu_si128(dst + 3, _mm_xor_si128(b3, _mm_loadu_si128(src + 3)));
+            _mm_storeu_si128(dst + 4, _mm_xor_si128(b4, _mm_loadu_si128(src + 4)));
+            _mm_storeu_si128(dst + 5, _mm_xor_si128(b5, _mm_loadu_si128(src + 5)));
+            _mm_storeu_si128(dst + 6, _mm_xor_si128(b6, _mm_loadu_si128(src + 6)));
+            _mm_storeu_si128(dst + 7, _mm_xor_si128(b7, _mm_loadu_si128(src + 7)));
+            x = Reduce(lo, mid, hi);
+            src += 8;
+            dst += 8;
+            nblocks -= 8;
+        }
+
+        // hash the last full batch
+        const __m128i* prev = dst - 8;
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        MulAcc(_mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(prev + 0), bswap)), h[7], lo, mid, hi);
+        for (int i = 1; i < 8; ++i)
+            MulAcc(_mm_shuffle_epi8(_mm_loadu_si128(prev + i), bswap), h[7 - i], lo, mid, hi);
+        x = Reduce(lo, mid, hi);
+    }
+
+    if (nblocks > 0) {
+        __m128i ks[8];
+        TailKeystream(ctr, rk, rounds, bswap, ks);
+        ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, static_cast<int>(nblocks)));
+        for (size_t i = 0; i < nblocks; ++i)
+            _mm_storeu_si128(dst + i, _mm_xor_si128(ks[i], _mm_loadu_si128(src + i)));
+        x = GhashChunk(x, dst, nblocks, h, bswap);
+    }
+
+    _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, bswap));
+    _mm_storeu_si128((__m128i*)counter, _mm_shuffle_epi8(ctr, bswap));
+}
+
+STITCH_TARGET
+void CLMUL_AESNI_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[8][16],
+                            uint8_t counter[16], uint8_t X[16],
+                            const uint8_t* in, uint8_t* out, size_t nblocks) {
+    __m128i rk[15];
+    LoadRoundKeys(roundKeys, rounds, rk);
+    const __m128i bswap = ByteSwapMask();
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Hpow[i]), bswap);
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), bswap);
+    __m128i ctr = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)counter), bswap);
+
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    while (nblocks >= 8) {
+        // GHASH consumes the ciphertext batch being decrypted; it is read
+        // before any store, so in == out is safe
+        __m128i c0 = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128(src + 0), bswap));
+        __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128(src + 1), bswap);
+        __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128(src + 2), bswap);
+        __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128(src + 3), bswap);
+        __m128i c4 = _mm_shuffle_epi8(_mm_loadu_si128(src + 4), bswap);
+        __m128i c5 = _mm_shuffle_epi8(_mm_loadu_si128(src + 5), bswap);
+        __m128i c6 = _mm_shuffle_epi8(_mm_loadu_si128(src + 6), bswap);
+        __m128i c7 = _mm_shuffle_epi8(_mm_loadu_si128(src + 7), bswap);
+        __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+        STITCH_COUNTERS();
+        STITCH_ROUNDS_WITH_GHASH(c0, c1, c2, c3, c4, c5, c6, c7);
+        _mm_storeu_si128(dst + 0, _mm_xor_si128(b0, _mm_loadu_si128(src + 0)));
+        _mm_storeu_si128(dst + 1, _mm_xor_si128(b1, _mm_loadu_si128(src + 1)));
+        _mm_storeu_si128(dst + 2, _mm_xor_si128(b2, _mm_loadu_si128(src + 2)));
+        _mm_storeu_si128(dst + 3, _mm_xor_si128(b3, _mm_loadu_si128(src + 3)));
+        _mm_storeu_si128(dst + 4, _mm_xor_si128(b4, _mm_loadu_si128(src + 4)));
+        _mm_storeu_si128(dst + 5, _mm_xor_si128(b5, _mm_loadu_si128(src + 5)));
+        _mm_storeu_si128(dst + 6, _mm_xor_si128(b6, _mm_loadu_si128(src + 6)));
+        _mm_storeu_si128(dst + 7, _mm_xor_si128(b7, _mm_loadu_si128(src + 7)));
+        x = Reduce(lo, mid, hi);
+        src += 8;
+        dst += 8;
+        nblocks -= 8;
+    }
+
+    if (nblocks > 0) {
+        x = GhashChunk(x, src, nblocks, h, bswap); // before the stores: in may equal out
+        __m128i ks[8];
+        TailKeystream(ctr, rk, rounds, bswap, ks);
+        ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, static_cast<int>(nblocks)));
+        for (size_t i = 0; i < nblocks; ++i)
+            _mm_storeu_si128(dst + i, _mm_xor_si128(ks[i], _mm_loadu_si128(src + i)));
+    }
+
+    _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, bswap));
+    _mm_storeu_si128((__m128i*)counter, _mm_shuffle_epi8(ctr, bswap));
+}
+
+#undef STITCH_COUNTERS
+#undef STITCH_AESENC
+#undef STITCH_AESENCLAST
+#undef STITCH_ROUNDS_WITH_GHASH
+
+#else // !AESGCM_X86
+
+void CLMUL_GhashBlocks(const uint8_t[8][16], uint8_t[16], const uint8_t*, size_t) {}
+void CLMUL_GhashMulti(const uint8_t[8][16], size_t, const uint8_t* const*, const size_t*, uint8_t (*)[16]) {}
+void CLMUL_AESNI_GcmEncrypt(const uint8_t*, int, const uint8_t[8][16], uint8_t[16], uint8_t[16],
+                            const uint8_t*, uint8_t*, size_t) {}
+void CLMUL_AESNI_GcmDecrypt(const uint8_t*, int, const uint8_t[8][16], uint8_t[16], uint8_t[16],
+                            const uint8_t*, uint8_t*, size_t) {}
+
+#endif
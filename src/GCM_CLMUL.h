@@ -0,0 +1,35 @@
+#ifndef GCM_CLMUL_H
+#define GCM_CLMUL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// x86 PCLMULQDQ GHASH kernels. Values use GCM's own byte order (the same
+// 16-byte big-endian bitstrings AES256_GCM keeps in H and Htable).
+// Callers must check GetCpuFeatures().pclmul before calling.
+
+// X = (...((X ^ B1) * H ^ B2) * H ...) * H over nblocks full 16-byte blocks.
+// Hpow[i] holds H^(i+1); eight blocks share one reduction:
+//   X' = (X ^ B1)*H^8 ^ B2*H^7 ^ ... ^ B8*H
+void CLMUL_GhashBlocks(const uint8_t Hpow[8][16], uint8_t X[16],
+                       const uint8_t* data, size_t nblocks);
+
+// Independent GHASH streams (one per message) hashed side by side, four at a
+// time, so short messages do not each wait out a full multiply/reduce
+// latency chain: X[s] absorbs nblocks[s] blocks from data[s].
+void CLMUL_GhashMulti(const uint8_t Hpow[8][16], size_t streams,
+                      const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]);
+
+// Stitched AES-NI CTR + PCLMULQDQ GHASH over nblocks full blocks, one pass.
+// Same counter contract as AESNI_Ctr32; X absorbs the ciphertext. Encrypt
+// hashes batch i-1 while the AES rounds of batch i run; decrypt hashes each
+// ciphertext batch while its keystream is computed. in may equal out.
+// Requires both GetCpuFeatures().aesni and .pclmul.
+void CLMUL_AESNI_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[8][16],
+                            uint8_t counter[16], uint8_t X[16],
+                            const uint8_t* in, uint8_t* out, size_t nblocks);
+void CLMUL_AESNI_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[8][16],
+                            uint8_t counter[16], uint8_t X[16],
+                            const uint8_t* in, uint8_t* out, size_t nblocks);
+
+#endif
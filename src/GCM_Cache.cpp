@@ -0,0 +1,108 @@
+#include "GCM_Cache.h"
+#include "SecureZero.h"
+#include "Utils.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+AES256 RandomCipher(AES256::Backend backend) {
+    std::vector<uint8_t> k = randomBytes(32);
+    AES256 aes(k, backend);
+    SecureZero(k.data(), k.size());
+    return aes;
+}
+
+} // namespace
+
+AES256_GCM_Cache::AES256_GCM_Cache(size_t capacity, AES256::Backend aesBackend)
+    : capacity(capacity), aesBackend(aesBackend), fingerprintKey(RandomCipher(aesBackend)) {}
+
+size_t AES256_GCM_Cache::FingerprintHash::operator()(const Fingerprint& f) const {
+    size_t h;
+    std::memcpy(&h, f.data(), sizeof(h));
+    return h;
+}
+
+AES256_GCM_Cache::Fingerprint AES256_GCM_Cache::FingerprintOf(const std::vector<uint8_t>& key) const {
+    // CBC-MAC over exactly two blocks: a PRF for fixed-length input
+    Fingerprint fp;
+    std::memcpy(fp.data(), key.data(), 16);
+    fingerprintKey.EncryptBlock(fp.data());
+    for (int i = 0; i < 16; ++i) fp[i] ^= key[16 + i];
+    fingerprintKey.EncryptBlock(fp.data());
+    return fp;
+}
+
+std::shared_ptr<const AES256_GCM> AES256_GCM_Cache::Get(const std::vector<uint8_t>& key) {
+    if (key.size() != 32) throw std::invalid_argument("AES-256 key must be 32 bytes");
+    const Fingerprint fp = FingerprintOf(key);
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        auto it = index.find(fp);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            ++hits;
+            return it->second->ctx;
+        }
+        ++misses;
+    }
+
+    auto ctx = std::make_shared<const AES256_GCM>(key, aesBackend);
+
+    // declared before the lock: the evicted context is released (and wiped)
+    // after the mutex is unlocked
+    std::shared_ptr<const AES256_GCM> victim;
+    std::lock_guard<std::mutex> lk(mtx);
+    auto it = index.find(fp);
+    if (it != index.end()) { // another thread built the same key meanwhile
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->ctx;
+    }
+    if (capacity == 0) return ctx;
+    if (lru.size() >= capacity) {
+        victim = std::move(lru.back().ctx);
+        index.erase(lru.back().fp);
+        lru.pop_back();
+        ++evictions;
+    }
+    lru.push_front(Entry{fp, ctx});
+    index.emplace(fp, lru.begin());
+    return ctx;
+}
+
+bool AES256_GCM_Cache::Erase(const std::vector<uint8_t>& key) {
+    if (key.size() != 32) return false;
+    const Fingerprint fp = FingerprintOf(key);
+    std::shared_ptr<const AES256_GCM> victim;
+    std::lock_guard<std::mutex> lk(mtx);
+    auto it = index.find(fp);
+    if (it == index.end()) return false;
+    victim = std::move(it->second->ctx);
+    lru.erase(it->second);
+    index.erase(it);
+    return true;
+}
+
+void AES256_GCM_Cache::Clear() {
+    std::list<Entry> dropped;
+    std::lock_guard<std::mutex> lk(mtx);
+    dropped.swap(lru);
+    index.clear();
+}
+
+AES256_GCM_Cache::Stats AES256_GCM_Cache::GetStats() const {
+    std::lock_guard<std::mutex> lk(mtx);
+    Stats s;
+    s.hits = hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    s.size = lru.size();
+    s.capacity = capacity;
+    return s;
+}
+
+void AES256_GCM_Cache::ResetStats() {
+    std::lock_guard<std::mutex> lk(mtx);
+    hits = misses = evictions = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef GCM_CACHE_H
+#define GCM_CACHE_H
+
+#include "AES_256.h"
+#include "GCM.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU cache of ready AES256_GCM contexts for services that switch
+// among many keys: a repeat key costs one fingerprint (two AES blocks) and a
+// hash lookup instead of key expansion + H tables. Thread-safe.
+//
+// Entries are indexed by a keyed fingerprint of the key (AES-CBC-MAC under a
+// random per-cache key), so the cache never stores or compares raw keys.
+// An evicted context is zeroized once the last shared_ptr to it is dropped.
+class AES256_GCM_Cache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // capacity 0 disables caching (every Get builds a fresh context).
+    // Contexts are built with aesBackend.
+    explicit AES256_GCM_Cache(size_t capacity = 1024,
+                              AES256::Backend aesBackend = AES256::DefaultBackend());
+
+    AES256_GCM_Cache(const AES256_GCM_Cache&) = delete;
+    AES256_GCM_Cache& operator=(const AES256_GCM_Cache&) = delete;
+
+    // Context for key (32 bytes, else std::invalid_argument), built on a miss.
+    // Key setup runs outside the lock, so other keys keep being served.
+    // Hold the returned pointer for as long as the context is used (e.g. by
+    // an AES256_GCM_Stream): eviction only drops the cache's reference.
+    std::shared_ptr<const AES256_GCM> Get(const std::vector<uint8_t>& key);
+
+    // Drop one key (rotation / tenant removal); returns true if it was cached
+    bool Erase(const std::vector<uint8_t>& key);
+    void Clear();
+
+    Stats GetStats() const;
+    void ResetStats();
+
+private:
+    using Fingerprint = std::array<uint8_t, 16>;
+    struct FingerprintHash {
+        size_t operator()(const Fingerprint& f) const; // f is already a PRF output
+    };
+    struct Entry {
+        Fingerprint fp;
+        std::shared_ptr<const AES256_GCM> ctx;
+    };
+
+    Fingerprint FingerprintOf(const std::vector<uint8_t>& key) const;
+
+    const size_t capacity;
+    const AES256::Backend aesBackend;
+    const AES256 fingerprintKey; // random, never leaves the process
+
+    mutable std::mutex mtx;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<Fingerprint, std::list<Entry>::iterator, FingerprintHash> index;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+};
+
+#endif
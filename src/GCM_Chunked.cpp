@@ -0,0 +1,348 @@
+#include "GCM_Chunked.h"
+#include "Nonce.h"
+#include "SecureZero.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const uint8_t kMagic[4] = {'A', 'G', 'C', 'S'};
+const uint8_t kVersion = 1;
+const uint8_t kFlagSalt = 0x01;
+
+// header offsets
+const size_t kOffChunk = 8;
+const size_t kOffSeed = 12;
+const size_t kOffSalt = 24;
+const size_t kOffReserved = 40;
+
+void PutBE32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+uint32_t GetBE32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+// nonce = index (uint64 BE) || 0,0,0 || last flag
+void ChunkNonce(uint64_t index, bool last, uint8_t nonce[12]) {
+    for (int i = 0; i < 8; ++i) nonce[i] = uint8_t(index >> (56 - 8 * i));
+    nonce[8] = nonce[9] = nonce[10] = 0;
+    nonce[11] = last ? 1 : 0;
+}
+
+// fn(i) for i in [0, n): on the pool, or inline without one
+void ForEach(size_t n, ThreadPool* pool, const std::function<void(size_t)>& fn) {
+    if (pool) pool->ParallelFor(n, fn);
+    else for (size_t i = 0; i < n; ++i) fn(i);
+}
+
+// Chunks per stream batch: two per pool thread keeps everyone busy
+size_t StreamBatch(ThreadPool* pool) {
+    return pool ? 2 * pool->Concurrency() : 1;
+}
+
+// Reads up to n bytes; short only at end of stream
+size_t ReadFull(std::istream& in, uint8_t* p, size_t n) {
+    in.read(reinterpret_cast<char*>(p), std::streamsize(n));
+    return size_t(in.gcount());
+}
+
+} // namespace
+
+AES256_GCM_Chunked::AES256_GCM_Chunked(const AES256_GCM& master, uint32_t chunkBytes,
+                                       const std::vector<uint8_t>& salt)
+    : AES256_GCM_Chunked(master, NewHeader(chunkBytes, salt).data()) {}
+
+AES256_GCM_Chunked::AES256_GCM_Chunked(const AES256_GCM& master, const uint8_t h[HeaderBytes])
+    : chunkBytes(ParseHeader(h)), gcm(DeriveFileContext(master, h + kOffSeed))
+{
+    std::memcpy(header, h, HeaderBytes);
+}
+
+std::array<uint8_t, AES256_GCM_Chunked::HeaderBytes>
+AES256_GCM_Chunked::NewHeader(uint32_t chunkBytes, const std::vector<uint8_t>& salt) {
+    if (chunkBytes == 0 || chunkBytes % 16 != 0 || chunkBytes > MaxChunkBytes)
+        throw std::invalid_argument("chunk size must be a multiple of 16, at most 1 GiB");
+    if (!salt.empty() && salt.size() != 16) throw std::invalid_argument("salt must be 16 bytes");
+    uint8_t seed[12];
+    if (!fastRandomBytes(seed, sizeof(seed))) throw std::runtime_error("cannot generate random seed");
+
+    std::array<uint8_t, HeaderBytes> h{};
+    std::memcpy(h.data(), kMagic, sizeof(kMagic));
+    h[4] = kVersion;
+    h[5] = salt.empty() ? 0 : kFlagSalt;
+    PutBE32(h.data() + kOffChunk, chunkBytes);
+    std::memcpy(h.data() + kOffSeed, seed, 12);
+    if (!salt.empty()) std::memcpy(h.data() + kOffSalt, salt.data(), 16);
+    return h;
+}
+
+uint32_t AES256_GCM_Chunked::ParseHeader(const uint8_t h[HeaderBytes]) {
+    if (std::memcmp(h, kMagic, sizeof(kMagic)) != 0) throw std::runtime_error("not a chunked GCM container");
+    if (h[4] != kVersion) throw std::runtime_error("unsupported container version");
+    bool ok = (h[5] & ~kFlagSalt) == 0 && h[6] == 0 && h[7] == 0;
+    for (size_t i = kOffReserved; i < HeaderBytes; ++i) ok = ok && h[i] == 0;
+    if (!(h[5] & kFlagSalt))
+        for (size_t i = kOffSalt; i < kOffSalt + 16; ++i) ok = ok && h[i] == 0;
+    uint32_t cs = GetBE32(h + kOffChunk);
+    if (!ok || cs == 0 || cs % 16 != 0 || cs > MaxChunkBytes)
+        throw std::runtime_error("malformed container header");
+    return cs;
+}
+
+std::vector<uint8_t> AES256_GCM_Chunked::ReadSalt(const uint8_t h[HeaderBytes]) {
+    ParseHeader(h);
+    if (!(h[5] & kFlagSalt)) return {};
+    return std::vector<uint8_t>(h + kOffSalt, h + kOffSalt + 16);
+}
+
+AES256_GCM AES256_GCM_Chunked::DeriveFileContext(const AES256_GCM& master, const uint8_t seed[12]) {
+    // file key = two keystream blocks of the master key at seed || FFFFFFF1,
+    // seed || FFFFFFF2: counters a GCM message under IV = seed would only
+    // reach after ~64 GiB, so the KDF output never doubles as keystream
+    uint8_t icb[16];
+    std::memcpy(icb, seed, 12);
+    icb[12] = 0xFF; icb[13] = 0xFF; icb[14] = 0xFF; icb[15] = 0xF0;
+    const uint8_t zero[32] = {0};
+    std::vector<uint8_t> key(32);
+    master.GCTR(icb, zero, key.data(), key.size());
+    AES256_GCM ctx(key, master.GetAesBackend());
+    ctx.SetGhashBackend(master.GetGhashBackend());
+    SecureZero(key.data(), key.size());
+    return ctx;
+}
+
+uint64_t AES256_GCM_Chunked::ChunkCount(uint64_t plainLen, uint32_t chunkBytes) {
+    // an empty file still has its (empty) final chunk
+    return plainLen == 0 ? 1 : (plainLen + chunkBytes - 1) / chunkBytes;
+}
+
+uint64_t AES256_GCM_Chunked::ContainerSize(uint64_t plainLen, uint32_t chunkBytes) {
+    return HeaderBytes + plainLen + TagBytes * ChunkCount(plainLen, chunkBytes);
+}
+
+uint64_t AES256_GCM_Chunked::PlaintextSize(uint64_t containerLen) const {
+    if (containerLen < HeaderBytes + TagBytes) throw std::runtime_error("container too short");
+    const uint64_t body = containerLen - HeaderBytes;
+    const uint64_t n = (body + FrameBytes() - 1) / FrameBytes();
+    const uint64_t tail = body - (n - 1) * FrameBytes();
+    // the final frame carries at least one byte unless it is the only one
+    if (tail < TagBytes || (n > 1 && tail == TagBytes))
+        throw std::runtime_error("container length does not match its chunk size");
+    return body - n * TagBytes;
+}
+
+std::vector<uint8_t> AES256_GCM_Chunked::ChunkAad(const uint8_t* aad, size_t aadLen) const {
+    std::vector<uint8_t> ad(header, header + HeaderBytes);
+    if (aadLen) ad.insert(ad.end(), aad, aad + aadLen);
+    return ad;
+}
+
+void AES256_GCM_Chunked::SealChunk(uint64_t index, bool last, const uint8_t* in, size_t len,
+                                   const std::vector<uint8_t>& aad, uint8_t* frame) const {
+    uint8_t nonce[12];
+    ChunkNonce(index, last, nonce);
+    gcm.Encrypt(nonce, sizeof(nonce), in, len, aad.data(), aad.size(), frame, frame + len);
+}
+
+void AES256_GCM_Chunked::OpenChunk(uint64_t index, bool last, const uint8_t* frame, size_t len,
+                                   const std::vector<uint8_t>& aad, uint8_t* out) const {
+    uint8_t nonce[12];
+    ChunkNonce(index, last, nonce);
+    try {
+        gcm.Decrypt(nonce, sizeof(nonce), frame, len, aad.data(), aad.size(), frame + len, out);
+    } catch (const std::runtime_error&) {
+        throw std::runtime_error("chunk " + std::to_string(index) + " failed authentication");
+    }
+}
+
+void AES256_GCM_Chunked::Encrypt(const uint8_t* plaintext, size_t len,
+                                 const uint8_t* aad, size_t aadLen, uint8_t* out,
+                                 ThreadPool* pool) const {
+    std::memcpy(out, header, HeaderBytes);
+    const std::vector<uint8_t> ad = ChunkAad(aad, aadLen);
+    const size_t n = size_t(ChunkCount(len, chunkBytes));
+    uint8_t* frames = out + HeaderBytes;
+    ForEach(n, pool, [&](size_t i) {
+        size_t off = i * chunkBytes;
+        size_t clen = std::min<size_t>(chunkBytes, len - off);
+        SealChunk(i, i + 1 == n, plaintext + off, clen, ad, frames + i * FrameBytes());
+    });
+}
+
+void AES256_GCM_Chunked::Decrypt(const uint8_t* container, size_t containerLen,
+                                 const uint8_t* aad, size_t aadLen, uint8_t* plaintext,
+                                 ThreadPool* pool) const {
+    if (containerLen < HeaderBytes || std::memcmp(container, header, HeaderBytes) != 0)
+        throw std::runtime_error("container header does not match");
+    const size_t len = size_t(PlaintextSize(containerLen));
+    const std::vector<uint8_t> ad = ChunkAad(aad, aadLen);
+    const size_t n = size_t(ChunkCount(len, chunkBytes));
+    const uint8_t* frames = container + HeaderBytes;
+    try {
+        ForEach(n, pool, [&](size_t i) {
+            size_t off = i * chunkBytes;
+            size_t clen = std::min<size_t>(chunkBytes, len - off);
+            OpenChunk(i, i + 1 == n, frames + i * FrameBytes(), clen, ad, plaintext + off);
+        });
+    } catch (...) {
+        if (len) std::memset(plaintext, 0, len);
+        throw;
+    }
+}
+
+void AES256_GCM_Chunked::Verify(const uint8_t* container, size_t containerLen,
+                                const uint8_t* aad, size_t aadLen, ThreadPool* pool) const {
+    if (containerLen < HeaderBytes || std::memcmp(container, header, HeaderBytes) != 0)
+        throw std::runtime_error("container header does not match");
+    const size_t len = size_t(PlaintextSize(containerLen));
+    const std::vector<uint8_t> ad = ChunkAad(aad, aadLen);
+    const size_t n = size_t(ChunkCount(len, chunkBytes));
+    const uint8_t* frames = container + HeaderBytes;
+    ForEach(n, pool, [&](size_t i) {
+        size_t clen = std::min<size_t>(chunkBytes, len - i * chunkBytes);
+        const uint8_t* frame = frames + i * FrameBytes();
+        uint8_t nonce[12];
+        ChunkNonce(i, i + 1 == n, nonce);
+        if (!gcm.Verify(nonce, sizeof(nonce), frame, clen, ad.data(), ad.size(), frame + clen))
+            throw std::runtime_error("chunk " + std::to_string(i) + " failed authentication");
+    });
+}
+
+void AES256_GCM_Chunked::OpenRange(const uint8_t* frames, uint64_t plainLen, uint64_t offset, size_t len,
+                                   const std::vector<uint8_t>& aad, uint8_t* out, ThreadPool* pool) const {
+    const uint64_t chunks = ChunkCount(plainLen, chunkBytes);
+    const uint64_t first = offset / chunkBytes;
+    const uint64_t last = (offset + len - 1) / chunkBytes;
+    try {
+        ForEach(size_t(last - first + 1), pool, [&](size_t k) {
+            const uint64_t i = first + k;
+            const uint64_t cOff = i * chunkBytes;
+            const size_t clen = size_t(std::min<uint64_t>(chunkBytes, plainLen - cOff));
+            const uint8_t* frame = frames + k * FrameBytes();
+            const uint64_t from = std::max(offset, cOff);
+            const uint64_t to = std::min(offset + len, cOff + clen);
+            uint8_t* dst = out + (from - offset);
+            if (from == cOff && to == cOff + clen) {
+                OpenChunk(i, i + 1 == chunks, frame, clen, aad, dst);
+                return;
+            }
+            // edge chunk: authenticate all of it, hand out only the range
+            std::vector<uint8_t> tmp(clen);
+            OpenChunk(i, i + 1 == chunks, frame, clen, aad, tmp.data());
+            std::memcpy(dst, tmp.data() + (from - cOff), size_t(to - from));
+            SecureZero(tmp.data(), tmp.size());
+        });
+    } catch (...) {
+        std::memset(out, 0, len);
+        throw;
+    }
+}
+
+void AES256_GCM_Chunked::DecryptRange(const uint8_t* container, size_t containerLen,
+                                      uint64_t offset, size_t len,
+                                      const uint8_t* aad, size_t aadLen, uint8_t* out,
+                                      ThreadPool* pool) const {
+    if (containerLen < HeaderBytes || std::memcmp(container, header, HeaderBytes) != 0)
+        throw std::runtime_error("container header does not match");
+    const uint64_t plainLen = PlaintextSize(containerLen);
+    if (offset > plainLen || len > plainLen - offset)
+        throw std::invalid_argument("range past the end of the container");
+    if (len == 0) return;
+    const uint8_t* frames = container + HeaderBytes + (offset / chunkBytes) * FrameBytes();
+    OpenRange(frames, plainLen, offset, len, ChunkAad(aad, aadLen), out, pool);
+}
+
+void AES256_GCM_Chunked::DecryptRange(std::istream& in, uint64_t containerLen,
+                                      uint64_t offset, size_t len,
+                                      const uint8_t* aad, size_t aadLen, uint8_t* out,
+                                      ThreadPool* pool) const {
+    uint8_t h[HeaderBytes];
+    in.seekg(0);
+    if (ReadFull(in, h, HeaderBytes) != HeaderBytes || std::memcmp(h, header, HeaderBytes) != 0)
+        throw std::runtime_error("container header does not match");
+    const uint64_t plainLen = PlaintextSize(containerLen);
+    if (offset > plainLen || len > plainLen - offset)
+        throw std::invalid_argument("range past the end of the container");
+    if (len == 0) return;
+
+    // read only the frames that cover the range
+    const uint64_t first = offset / chunkBytes;
+    const uint64_t last = (offset + len - 1) / chunkBytes;
+    const uint64_t pos = HeaderBytes + first * FrameBytes();
+    const uint64_t bytes = std::min((last - first + 1) * FrameBytes(), containerLen - pos);
+    std::vector<uint8_t> frames(static_cast<size_t>(bytes));
+    in.seekg(std::streamoff(pos));
+    if (ReadFull(in, frames.data(), frames.size()) != frames.size())
+        throw std::runtime_error("container shorter than expected");
+    OpenRange(frames.data(), plainLen, offset, len, ChunkAad(aad, aadLen), out, pool);
+}
+
+void AES256_GCM_Chunked::EncryptStream(std::istream& in, std::ostream& out,
+                                       const uint8_t* aad, size_t aadLen,
+                                       ThreadPool* pool) const {
+    out.write(reinterpret_cast<const char*>(header), HeaderBytes);
+    const std::vector<uint8_t> ad = ChunkAad(aad, aadLen);
+    const size_t batch = StreamBatch(pool);
+    std::vector<uint8_t> pt(batch * chunkBytes);
+    std::vector<uint8_t> frames(batch * size_t(FrameBytes()));
+
+    uint64_t index = 0;
+    for (;;) {
+        const size_t have = ReadFull(in, pt.data(), pt.size());
+        // a full batch may still be the end: look one byte ahead
+        const bool eof = have < pt.size() || in.peek() == std::char_traits<char>::eof();
+        const size_t n = std::max<size_t>(1, (have + chunkBytes - 1) / chunkBytes);
+        ForEach(n, pool, [&](size_t k) {
+            size_t off = k * chunkBytes;
+            size_t clen = std::min<size_t>(chunkBytes, have - off);
+            SealChunk(index + k, eof && k + 1 == n, pt.data() + off, clen, ad,
+                      frames.data() + k * FrameBytes());
+        });
+        out.write(reinterpret_cast<const char*>(frames.data()), std::streamsize(have + n * TagBytes));
+        if (!out) throw std::runtime_error("cannot write container");
+        index += n;
+        if (eof) break;
+    }
+    if (in.bad()) throw std::runtime_error("cannot read input");
+    SecureZero(pt.data(), pt.size());
+}
+
+void AES256_GCM_Chunked::DecryptStream(std::istream& in, std::ostream& out,
+                                       const uint8_t* aad, size_t aadLen,
+                                       ThreadPool* pool) const {
+    const std::vector<uint8_t> ad = ChunkAad(aad, aadLen);
+    const size_t batch = StreamBatch(pool);
+    std::vector<uint8_t> frames(batch * size_t(FrameBytes()));
+    std::vector<uint8_t> pt(batch * chunkBytes);
+
+    uint64_t index = 0;
+    for (;;) {
+        const size_t have = ReadFull(in, frames.data(), frames.size());
+        const bool eof = have < frames.size() || in.peek() == std::char_traits<char>::eof();
+        if (have == 0) throw std::runtime_error("container truncated");
+        const size_t n = size_t((have + FrameBytes() - 1) / FrameBytes());
+        const size_t tail = have - size_t((n - 1) * FrameBytes());
+        if (tail < TagBytes || (index + n > 1 && tail == TagBytes))
+            throw std::runtime_error("container truncated");
+        ForEach(n, pool, [&](size_t k) {
+            size_t clen = k + 1 == n ? tail - TagBytes : chunkBytes;
+            OpenChunk(index + k, eof && k + 1 == n, frames.data() + k * FrameBytes(), clen, ad,
+                      pt.data() + k * chunkBytes);
+        });
+        out.write(reinterpret_cast<const char*>(pt.data()), std::streamsize(have - n * TagBytes));
+        if (!out) throw std::runtime_error("cannot write plaintext");
+        index += n;
+        if (eof) break;
+    }
+    if (in.bad()) throw std::runtime_error("cannot read container");
+    SecureZero(pt.data(), pt.size());
+}
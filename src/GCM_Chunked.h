@@ -0,0 +1,129 @@
+#ifndef GCM_CHUNKED_H
+#define GCM_CHUNKED_H
+
+#include "GCM.h"
+#include "ThreadPool.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Segmented, seekable AES-256-GCM container (STREAM construction):
+//
+//   header(48) || chunk_0 || tag_0 || chunk_1 || tag_1 || ... || chunk_n-1 || tag_n-1
+//
+// header = "AGCS" | version 1 | flags | 0,0 | chunk size (uint32 BE) |
+//          seed(12) | salt(16, zero if none) | 0 x 8
+//
+// Every chunk but the last holds exactly ChunkBytes() of plaintext; the last
+// holds 1..ChunkBytes() (0 only for an empty file). Chunk i is one GCM
+// message with nonce = i (uint64 BE) || 0,0,0 || last flag and AAD =
+// header || user AAD, under a per-file key derived from the master context
+// and the random seed. So each chunk is bound to its file, its position and
+// to whether it ends the file: reordering, splicing between files and
+// truncation at a chunk boundary all fail authentication. The chunk counter
+// is 64-bit, so file size is not limited by GCM's 2^36 - 32 byte message cap.
+//
+// Chunks are sealed and opened independently (in parallel with a pool) and
+// a byte range is decrypted by opening only the chunks that cover it.
+class AES256_GCM_Chunked {
+public:
+    static constexpr size_t HeaderBytes = 48;
+    static constexpr size_t TagBytes = 16;
+    static constexpr uint32_t DefaultChunkBytes = uint32_t(1) << 20;
+    static constexpr uint32_t MaxChunkBytes = uint32_t(1) << 30;
+
+    // New container: random seed; chunkBytes must be a non-zero multiple of
+    // 16 up to MaxChunkBytes; salt is empty or 16 bytes (PBKDF2 salt, stored
+    // in the header in the clear). The master context only has to live
+    // through the constructor.
+    AES256_GCM_Chunked(const AES256_GCM& master, uint32_t chunkBytes = DefaultChunkBytes,
+                       const std::vector<uint8_t>& salt = {});
+    // Existing container, from its first HeaderBytes bytes; throws
+    // std::runtime_error if the header is malformed
+    AES256_GCM_Chunked(const AES256_GCM& master, const uint8_t header[HeaderBytes]);
+
+    // Salt stored in a header (empty if none), readable before the key is known
+    static std::vector<uint8_t> ReadSalt(const uint8_t header[HeaderBytes]);
+
+    const uint8_t* Header() const { return header; }
+    uint32_t ChunkBytes() const { return chunkBytes; }
+
+    // Container size for plainLen bytes of plaintext (header included)
+    static uint64_t ContainerSize(uint64_t plainLen, uint32_t chunkBytes = DefaultChunkBytes);
+    // Plaintext size of a container of containerLen bytes; throws
+    // std::runtime_error if no container with this chunk size has that length
+    uint64_t PlaintextSize(uint64_t containerLen) const;
+
+    // In-memory / mmapped buffers. pool = nullptr runs on the calling thread.
+    // out holds ContainerSize(len, ChunkBytes()) bytes, header included.
+    void Encrypt(const uint8_t* plaintext, size_t len,
+                 const uint8_t* aad, size_t aadLen, uint8_t* out,
+                 ThreadPool* pool = &ThreadPool::Shared()) const;
+    // Whole container (header included) into PlaintextSize(containerLen)
+    // bytes. Throws std::runtime_error if any chunk fails; plaintext is then
+    // zeroed.
+    void Decrypt(const uint8_t* container, size_t containerLen,
+                 const uint8_t* aad, size_t aadLen, uint8_t* plaintext,
+                 ThreadPool* pool = &ThreadPool::Shared()) const;
+    // Authenticates every chunk (GHASH only, nothing decrypted). Throws
+    // std::runtime_error naming the first bad chunk it finds.
+    void Verify(const uint8_t* container, size_t containerLen,
+                const uint8_t* aad, size_t aadLen,
+                ThreadPool* pool = &ThreadPool::Shared()) const;
+    // Plaintext bytes [offset, offset + len) only. Opens just the chunks that
+    // cover the range; each is authenticated (position included) before any
+    // of its bytes are returned. Truncation is only detected when the range
+    // reaches the last chunk. Throws std::invalid_argument past the end.
+    void DecryptRange(const uint8_t* container, size_t containerLen,
+                      uint64_t offset, size_t len,
+                      const uint8_t* aad, size_t aadLen, uint8_t* out,
+                      ThreadPool* pool = &ThreadPool::Shared()) const;
+
+    // Streams of any size, bounded memory (a few chunks per pool thread).
+    // EncryptStream writes the header, then reads in until EOF.
+    void EncryptStream(std::istream& in, std::ostream& out,
+                       const uint8_t* aad, size_t aadLen,
+                       ThreadPool* pool = &ThreadPool::Shared()) const;
+    // in is positioned right after the header. Plaintext of verified chunks
+    // is written as it goes; if this throws (forged chunk, truncation), the
+    // caller must discard everything written.
+    void DecryptStream(std::istream& in, std::ostream& out,
+                       const uint8_t* aad, size_t aadLen,
+                       ThreadPool* pool = &ThreadPool::Shared()) const;
+    // Random access on a seekable stream holding the whole container
+    // (containerLen bytes from position 0); same rules as the buffer version
+    void DecryptRange(std::istream& in, uint64_t containerLen,
+                      uint64_t offset, size_t len,
+                      const uint8_t* aad, size_t aadLen, uint8_t* out,
+                      ThreadPool* pool = &ThreadPool::Shared()) const;
+
+private:
+    uint8_t header[HeaderBytes] = {0};
+    uint32_t chunkBytes = DefaultChunkBytes;
+    AES256_GCM gcm; // per-file key
+
+    static std::array<uint8_t, HeaderBytes> NewHeader(uint32_t chunkBytes, const std::vector<uint8_t>& salt);
+    // Validates h and returns its chunk size
+    static uint32_t ParseHeader(const uint8_t h[HeaderBytes]);
+    static AES256_GCM DeriveFileContext(const AES256_GCM& master, const uint8_t seed[12]);
+
+    uint64_t FrameBytes() const { return uint64_t(chunkBytes) + TagBytes; }
+    static uint64_t ChunkCount(uint64_t plainLen, uint32_t chunkBytes);
+    std::vector<uint8_t> ChunkAad(const uint8_t* aad, size_t aadLen) const;
+
+    void SealChunk(uint64_t index, bool last, const uint8_t* in, size_t len,
+                   const std::vector<uint8_t>& aad, uint8_t* frame) const;
+    // Throws std::runtime_error naming the chunk on a bad tag (out zeroed)
+    void OpenChunk(uint64_t index, bool last, const uint8_t* frame, size_t len,
+                   const std::vector<uint8_t>& aad, uint8_t* out) const;
+
+    // Opens the chunks covering plaintext [offset, offset + len) (len > 0) of
+    // a file with plainLen bytes; frames points at the frame of the first one
+    void OpenRange(const uint8_t* frames, uint64_t plainLen, uint64_t offset, size_t len,
+                   const std::vector<uint8_t>& aad, uint8_t* out, ThreadPool* pool) const;
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "GCM_Pipeline.h"
+#include "SecureZero.h"
+#include "SpscRing.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+AES256_GCM_Pipeline::AES256_GCM_Pipeline(const AES256_GCM& gcm, const Options& o)
+    : gcm(gcm), opt(o)
+{
+    if (opt.chunkBytes == 0 || opt.chunkBytes % 4096 != 0 || opt.chunkBytes > (size_t(1) << 30))
+        throw std::invalid_argument("pipeline chunk size must be a multiple of 4096, at most 1 GiB");
+    if (opt.depth < 2) throw std::invalid_argument("pipeline depth must be at least 2");
+    if (opt.workers == 0) throw std::invalid_argument("pipeline needs at least one worker");
+}
+
+#ifdef __linux__
+
+namespace {
+
+// O_DIRECT alignment of offsets, lengths and buffers (covers 512e and 4Kn disks)
+const size_t kAlign = 4096;
+
+[[noreturn]] void throwErrno(const std::string& what, const std::string& path) {
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+struct Fd {
+    int fd = -1;
+    ~Fd() { if (fd >= 0) ::close(fd); }
+};
+
+// Opens path with O_DIRECT when direct is set; clears direct if the
+// filesystem refuses it (tmpfs, some network filesystems)
+int OpenFile(const std::string& path, int flags, mode_t mode, bool& direct) {
+    if (direct) {
+        int fd = ::open(path.c_str(), flags | O_DIRECT | O_CLOEXEC, mode);
+        if (fd >= 0 || errno != EINVAL) return fd;
+        direct = false;
+    }
+    return ::open(path.c_str(), flags | O_CLOEXEC, mode);
+}
+
+// Output file under a temporary name beside path (path + ".XXXXXX", 0600).
+// Commit renames it over path; otherwise the destructor unlinks it, so a
+// failed run never truncates, replaces or removes an existing path.
+class TempOutput {
+public:
+    TempOutput(const std::string& path, bool& direct) : finalPath(path), tempPath(path + ".XXXXXX") {
+        out.fd = ::mkostemp(&tempPath[0], O_CLOEXEC);
+        if (out.fd < 0) throwErrno("cannot create", tempPath);
+        if (direct) {
+            int fl = ::fcntl(out.fd, F_GETFL);
+            if (fl < 0 || ::fcntl(out.fd, F_SETFL, fl | O_DIRECT) != 0) direct = false; // as OpenFile
+        }
+    }
+    ~TempOutput() {
+        if (!committed) ::unlink(tempPath.c_str());
+    }
+    TempOutput(const TempOutput&) = delete;
+    TempOutput& operator=(const TempOutput&) = delete;
+
+    int Fd() const { return out.fd; }
+
+    void Commit() {
+        int fd = out.fd;
+        out.fd = -1;
+        if (::close(fd) != 0) throwErrno("cannot close", tempPath);
+        if (::rename(tempPath.c_str(), finalPath.c_str()) != 0) throwErrno("cannot rename into", finalPath);
+        committed = true;
+    }
+
+private:
+    std::string finalPath;
+    std::string tempPath;
+    struct Fd out;
+    bool committed = false;
+};
+
+// Reads len bytes at pos into buf and returns where they start in buf. A
+// direct read covers the aligned blocks around [pos, pos + len), so buf must
+// hold len + 2 * kAlign bytes; a buffered read starts at buf[0].
+size_t ReadAt(int fd, bool direct, uint8_t* buf, uint64_t pos, size_t len) {
+    uint64_t start = direct ? pos & ~uint64_t(kAlign - 1) : pos;
+    size_t off = size_t(pos - start);
+    size_t want = direct ? (off + len + kAlign - 1) & ~(kAlign - 1) : len;
+    size_t got = 0;
+    while (got < off + len) {
+        ssize_t r = ::pread(fd, buf + got, want - got, off_t(start + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+        if (r == 0) throw std::runtime_error("input file shrank while reading");
+        got += size_t(r);
+    }
+    return off;
+}
+
+void WriteAt(int fd, const uint8_t* p, size_t n, uint64_t pos) {
+    while (n > 0) {
+        ssize_t r = ::pwrite(fd, p, n, off_t(pos));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+        p += r;
+        n -= size_t(r);
+        pos += uint64_t(r);
+    }
+}
+
+// Output stage. Buffered: each piece goes straight to its offset. Direct:
+// the byte stream is gathered in an aligned staging buffer and written in
+// whole blocks; Finish pads the last block and truncates the padding away.
+class OutputWriter {
+public:
+    OutputWriter(int fd, bool direct, size_t stageBytes, BufferPool& pool)
+        : fd(fd), stage(pool.Acquire(direct ? stageBytes : 0)), cap(stageBytes) {}
+
+    void Append(const uint8_t* p, size_t n) {
+        if (stage.Empty()) {
+            WriteAt(fd, p, n, end);
+            end += n;
+            return;
+        }
+        while (n > 0) {
+            size_t take = std::min(n, cap - fill);
+            std::memcpy(stage.Data() + fill, p, take);
+            fill += take;
+            p += take;
+            n -= take;
+            if (fill == cap) {
+                WriteAt(fd, stage.Data(), cap, end);
+                end += cap;
+                fill = 0;
+            }
+        }
+    }
+
+    void Finish() {
+        if (!stage.Empty() && fill > 0) {
+            size_t padded = (fill + kAlign - 1) & ~(kAlign - 1);
+            std::memset(stage.Data() + fill, 0, padded - fill);
+            WriteAt(fd, stage.Data(), padded, end);
+            end += fill;
+            fill = 0;
+            if (::ftruncate(fd, off_t(end)) != 0)
+                throw std::runtime_error(std::string("cannot truncate output: ") + std::strerror(errno));
+        }
+        if (::fdatasync(fd) != 0) throw std::runtime_error(std::string("write-back failed: ") + std::strerror(errno));
+    }
+
+private:
+    int fd;
+    BufferPool::Buffer stage;
+    size_t cap;
+    size_t fill = 0;
+    uint64_t end = 0; // bytes of the file written so far
+};
+
+struct Chunk {
+    uint8_t* buf;   // chunkBytes + 2 * kAlign bytes
+    size_t off;     // first data byte in buf
+    size_t len;
+    uint8_t Y[16];  // GHASH of this chunk's ciphertext from zero
+};
+
+// First failure of any stage; the rest see abort and wind down
+class Failure {
+public:
+    std::atomic<bool> abort{false};
+
+    void Set(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lk(m);
+        if (!ex) ex = e;
+        abort.store(true);
+    }
+    void Rethrow() {
+        if (ex) std::rethrow_exception(ex);
+    }
+
+private:
+    std::mutex m;
+    std::exception_ptr ex;
+};
+
+// Stage threads of one Run. If the owner unwinds before Join (a later
+// std::thread failed to start), the destructor raises abort, which makes
+// every ring Push/Pop give up, and joins the threads already running, so
+// no joinable std::thread is destroyed (std::terminate).
+class StageThreads {
+public:
+    StageThreads(Failure& f, size_t count) : fail(f) { threads.reserve(count); }
+    ~StageThreads() {
+        if (Joinable()) fail.abort.store(true);
+        Join();
+    }
+    StageThreads(const StageThreads&) = delete;
+    StageThreads& operator=(const StageThreads&) = delete;
+
+    template <class Fn>
+    void Start(Fn&& fn) { threads.emplace_back(std::forward<Fn>(fn)); }
+
+    void Join() {
+        for (std::thread& t : threads)
+            if (t.joinable()) t.join();
+    }
+
+private:
+    Failure& fail;
+    std::vector<std::thread> threads;
+
+    bool Joinable() const {
+        for (const std::thread& t : threads)
+            if (t.joinable()) return true;
+        return false;
+    }
+};
+
+} // namespace
+
+void AES256_GCM_Pipeline::Run(bool decrypt, const uint8_t J0[16], int inFd, bool inDirect,
+                              uint64_t inOffset, uint64_t len, int outFd, bool outDirect,
+                              const uint8_t* prefix, size_t prefixLen, uint8_t S[16]) const
+{
+    const size_t C = opt.chunkBytes;
+    const size_t W = opt.workers;
+    const uint64_t n = (len + C - 1) / C;
+    const size_t stride = C + 2 * kAlign;
+
+    BufferPool& pool = opt.pool ? *opt.pool : BufferPool::Shared();
+    std::vector<BufferPool::Buffer> bufs;
+    std::vector<Chunk> chunks(opt.depth);
+    SpscRing<Chunk*> freeRing(opt.depth); // writer -> reader
+    std::vector<std::unique_ptr<SpscRing<Chunk*>>> toWorker, toWriter;
+    for (size_t w = 0; w < W; ++w) {
+        toWorker.emplace_back(new SpscRing<Chunk*>(opt.depth));
+        toWriter.emplace_back(new SpscRing<Chunk*>(opt.depth));
+    }
+    for (size_t i = 0; i < opt.depth; ++i) {
+        bufs.push_back(pool.Acquire(stride));
+        chunks[i].buf = bufs.back().Data();
+        freeRing.TryPush(&chunks[i]);
+    }
+
+    Failure fail;
+    auto guarded = [&fail](auto&& body) {
+        try {
+            body();
+        } catch (...) {
+            fail.Set(std::current_exception());
+        }
+    };
+
+    StageThreads threads(fail, 1 + W);
+    threads.Start([&] {
+        guarded([&] {
+            for (uint64_t i = 0; i < n; ++i) {
+                Chunk* c;
+                if (!freeRing.Pop(c, fail.abort)) return;
+                c->len = size_t(std::min<uint64_t>(C, len - i * C));
+                c->off = ReadAt(inFd, inDirect, c->buf, inOffset + i * C, c->len);
+                if (!toWorker[i % W]->Push(c, fail.abort)) return;
+            }
+        });
+    });
+    for (size_t w = 0; w < W; ++w) {
+        threads.Start([&, w] {
+            guarded([&] {
+                for (uint64_t i = w; i < n; i += W) {
+                    Chunk* c;
+                    if (!toWorker[w]->Pop(c, fail.abort)) return;
+                    uint8_t counter[16];
+                    std::memcpy(counter, J0, 16);
+                    AES256_GCM::Inc32(counter);
+                    AES256_GCM::AddCounter(counter, uint32_t(i * (C / 16))); // len <= MaxMessageBytes
+                    std::memset(c->Y, 0, 16);
+                    uint8_t* p = c->buf + c->off;
+                    gcm.CryptAndHash(decrypt, counter, c->Y, p, p, c->len);
+                    if (!toWriter[w]->Push(c, fail.abort)) return;
+                }
+            });
+        });
+    }
+
+    // writer: chunks in file order, partial hashes folded as they arrive
+    guarded([&] {
+        OutputWriter out(outFd, outDirect, C, pool);
+        if (prefixLen) out.Append(prefix, prefixLen);
+        uint8_t Hc[16], Hlast[16];
+        gcm.HPower(C / 16, Hc);
+        for (uint64_t i = 0; i < n; ++i) {
+            Chunk* c;
+            if (!toWriter[i % W]->Pop(c, fail.abort)) return;
+            const uint8_t* Hn = Hc;
+            if (c->len != C) {
+                gcm.HPower((c->len + 15) / 16, Hlast);
+                Hn = Hlast;
+            }
+            AES256_GCM::GaloisMultiply(S, Hn, S);
+            for (int j = 0; j < 16; ++j) S[j] ^= c->Y[j];
+            out.Append(c->buf + c->off, c->len);
+            if (!freeRing.Push(c, fail.abort)) return;
+        }
+        out.Finish();
+    });
+
+    threads.Join();
+    fail.Rethrow();
+}
+
+void AES256_GCM_Pipeline::EncryptFile(const std::string& inPath, const std::string& outPath,
+                                      const std::vector<uint8_t>& salt, const std::vector<uint8_t>& iv,
+                                      const uint8_t* aad, size_t aadLen, uint8_t tag_out[16]) const
+{
+    uint8_t J0[16];
+    AES256_GCM::MakeJ0(iv.data(), iv.size(), J0);
+
+    bool inDirect = opt.direct;
+    Fd in;
+    in.fd = OpenFile(inPath, O_RDONLY, 0, inDirect);
+    if (in.fd < 0) throwErrno("cannot open", inPath);
+    struct stat st;
+    if (::fstat(in.fd, &st) != 0) throwErrno("cannot stat", inPath);
+    uint64_t len = uint64_t(st.st_size);
+    if (len > AES256_GCM::MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    bool outDirect = opt.direct;
+    TempOutput out(outPath, outDirect);
+    std::vector<uint8_t> prefix(salt);
+    prefix.insert(prefix.end(), iv.begin(), iv.end()); // SALT || IV
+    uint8_t S[16] = {0};
+    gcm.GhashPadded(S, aad, aadLen);
+    Run(false, J0, in.fd, inDirect, 0, len, out.Fd(), outDirect, prefix.data(), prefix.size(), S);
+    gcm.GhashLengths(S, aadLen, len);
+    gcm.aes.EncryptBlock(J0);
+    for (int i = 0; i < 16; ++i) tag_out[i] = J0[i] ^ S[i];
+    out.Commit();
+}
+
+void AES256_GCM_Pipeline::DecryptFile(const std::string& inPath, const std::string& outPath,
+                                      size_t saltLen, const uint8_t* aad, size_t aadLen,
+                                      const uint8_t tag[16]) const
+{
+    bool inDirect = opt.direct;
+    Fd in;
+    in.fd = OpenFile(inPath, O_RDONLY, 0, inDirect);
+    if (in.fd < 0) throwErrno("cannot open", inPath);
+    struct stat st;
+    if (::fstat(in.fd, &st) != 0) throwErrno("cannot stat", inPath);
+    size_t prefixLen = saltLen + 12;
+    if (uint64_t(st.st_size) < prefixLen) throw std::runtime_error("ciphertext file too short: " + inPath);
+    uint64_t len = uint64_t(st.st_size) - prefixLen;
+    if (len > AES256_GCM::MaxMessageBytes) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+
+    uint8_t J0[16];
+    {
+        BufferPool::Buffer head = (opt.pool ? *opt.pool : BufferPool::Shared()).Acquire(prefixLen + 2 * kAlign);
+        size_t off = ReadAt(in.fd, inDirect, head.Data(), 0, prefixLen);
+        AES256_GCM::MakeJ0(head.Data() + off + saltLen, 12, J0);
+    }
+
+    // unverified plaintext only ever lives under the temporary name
+    bool outDirect = opt.direct;
+    TempOutput out(outPath, outDirect);
+    uint8_t S[16] = {0};
+    gcm.GhashPadded(S, aad, aadLen);
+    Run(true, J0, in.fd, inDirect, prefixLen, len, out.Fd(), outDirect, nullptr, 0, S);
+    gcm.GhashLengths(S, aadLen, len);
+    gcm.aes.EncryptBlock(J0);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>((J0[i] ^ S[i]) ^ tag[i]);
+    if (diff != 0) throw std::runtime_error("GCM authentication failed!");
+    out.Commit();
+}
+
+#else
+
+void AES256_GCM_Pipeline::EncryptFile(const std::string&, const std::string&,
+                                      const std::vector<uint8_t>&, const std::vector<uint8_t>&,
+                                      const uint8_t*, size_t, uint8_t[16]) const {
+    throw std::runtime_error("pipelined file I/O is only available on Linux");
+}
+
+void AES256_GCM_Pipeline::DecryptFile(const std::string&, const std::string&,
+                                      size_t, const uint8_t*, size_t, const uint8_t[16]) const {
+    throw std::runtime_error("pipelined file I/O is only available on Linux");
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef GCM_PIPELINE_H
+#define GCM_PIPELINE_H
+
+#include "GCM.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Three-stage file encryptor (Linux): a reader thread, crypto workers and a
+// writer (the calling thread), connected by bounded SPSC rings (SpscRing.h)
+// of 4 KiB-aligned chunk buffers. Disk reads, AES-GCM and disk writes
+// overlap instead of taking turns, and memory stays at depth chunks no
+// matter how large the file is. A full ring stalls the stage feeding it, so
+// a slow disk throttles the reader instead of piling up buffers.
+//
+// Chunk i is encrypted in place by worker i % workers, from counter
+// J0 + 1 + i * chunkBytes / 16 with its own partial GHASH; the writer
+// takes chunks back in order and folds the partials with powers of H. The
+// result is one ordinary GCM message, byte-for-byte what
+// EncryptFileMapped writes: [Salt] || IV || ciphertext, tag kept separately.
+//
+// direct = true opens both files with O_DIRECT (no page cache; falls back to
+// buffered I/O on filesystems that refuse it). Reads fetch the aligned range
+// around each chunk; writes go through an aligned staging buffer, and the
+// padded tail is truncated away at the end.
+//
+// Chunk and staging buffers come from pool (BufferPool::Shared() if null),
+// so repeated files reuse the same memory; they are wiped on release when
+// the pool zeroizes, and a pool with lock keeps the plaintext out of swap.
+struct GcmPipelineOptions {
+    size_t chunkBytes = size_t(1) << 20; // multiple of 4096, at most 1 GiB
+    size_t depth = 4;                    // chunk buffers in flight (>= 2)
+    size_t workers = 1;                  // crypto threads
+    bool direct = false;
+    BufferPool* pool = nullptr;
+};
+
+class AES256_GCM_Pipeline {
+public:
+    using Options = GcmPipelineOptions;
+
+    // gcm must outlive the pipeline. Throws std::invalid_argument on bad options.
+    explicit AES256_GCM_Pipeline(const AES256_GCM& gcm, const Options& opt = Options());
+
+    const Options& GetOptions() const { return opt; }
+
+    // Same contract as EncryptFileMapped: written to a temporary beside
+    // outPath and renamed into place when complete
+    void EncryptFile(const std::string& inPath, const std::string& outPath,
+                     const std::vector<uint8_t>& salt, const std::vector<uint8_t>& iv,
+                     const uint8_t* aad, size_t aadLen, uint8_t tag_out[16]) const;
+
+    // Same contract as DecryptFileMapped. Plaintext is streamed (and
+    // fdatasync'ed) into a temporary beside outPath, which is renamed over
+    // outPath only after the tag matches; on a bad tag (or any other
+    // failure) the temporary is removed, outPath is not touched, and
+    // std::runtime_error is thrown.
+    void DecryptFile(const std::string& inPath, const std::string& outPath,
+                     size_t saltLen, const uint8_t* aad, size_t aadLen,
+                     const uint8_t tag[16]) const;
+
+private:
+    const AES256_GCM& gcm;
+    Options opt;
+
+    // Streams len bytes at inOffset of inFd through the stages into outFd
+    // after prefix; S holds the AAD hash on entry, the pre-length GHASH on exit
+    void Run(bool decrypt, const uint8_t J0[16], int inFd, bool inDirect, uint64_t inOffset,
+             uint64_t len, int outFd, bool outDirect, const uint8_t* prefix, size_t prefixLen,
+             uint8_t S[16]) const;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "GCM_Reservoir.h"
+#include "Nonce.h"
+#include "SecureZero.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Entries refilled per wake-up at most: bounds the time the thread holds slots
+const size_t kRefillBatch = 64;
+
+void XorBytes(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        x ^= y;
+        std::memcpy(out + i, &x, 8);
+    }
+    for (; i < n; ++i) out[i] = a[i] ^ b[i];
+}
+
+} // namespace
+
+AES256_GCM_Reservoir::AES256_GCM_Reservoir(std::shared_ptr<const AES256_GCM> gcm,
+                                           size_t entries, size_t maxMessageBytes)
+    : gcm(std::move(gcm)),
+      maxBytes((maxMessageBytes + 15) / 16 * 16),
+      entryBytes(16 + maxBytes),
+      refillAt(std::max<size_t>(1, entries / 4))
+{
+    if (!this->gcm) throw std::invalid_argument("reservoir needs a GCM context");
+    if (entries == 0) throw std::invalid_argument("reservoir needs at least one entry");
+    keystream.assign(entries * entryBytes, 0);
+    ivs.assign(entries * 12, 0);
+    for (size_t i = 0; i < entries; ++i) used.push_back(i);
+    filler = std::thread([this] { RefillLoop(); });
+}
+
+AES256_GCM_Reservoir::~AES256_GCM_Reservoir() {
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        stop = true;
+    }
+    wake.notify_all();
+    filler.join();
+    SecureZero(keystream.data(), keystream.size());
+}
+
+void AES256_GCM_Reservoir::FillEntry(size_t idx, const uint8_t iv[12]) {
+    std::memcpy(&ivs[idx * 12], iv, 12);
+    // GCTR from IV || 0 yields E_K(J0) first, then the data keystream from J0+1
+    uint8_t icb[16] = {0};
+    std::memcpy(icb, iv, 12);
+    uint8_t* ks = &keystream[idx * entryBytes];
+    std::memset(ks, 0, entryBytes);
+    gcm->GCTR(icb, ks, ks, entryBytes);
+}
+
+void AES256_GCM_Reservoir::RefillLoop() {
+    std::unique_lock<std::mutex> lk(mtx);
+    for (;;) {
+        // the first round finds every entry unused and fills the whole pool
+        wake.wait(lk, [this] {
+            return stop || used.size() >= refillAt || (ready.empty() && !used.empty());
+        });
+
+        // refill everything used so far, a batch at a time so Encrypt sees
+        // new entries before the whole pool is done
+        while (!stop && !used.empty()) {
+            std::vector<size_t> batch;
+            while (!used.empty() && batch.size() < kRefillBatch) {
+                batch.push_back(used.front());
+                used.pop_front();
+            }
+            lk.unlock();
+
+            std::vector<uint8_t> fresh = randomBytes(12 * batch.size());
+            bool ok = fresh.size() == 12 * batch.size();
+            if (ok)
+                for (size_t i = 0; i < batch.size(); ++i) FillEntry(batch[i], &fresh[12 * i]);
+
+            lk.lock();
+            if (!ok) {
+                // no entropy: hand the slots back and leave Encrypt on its slow path
+                used.insert(used.end(), batch.begin(), batch.end());
+                return;
+            }
+            ready.insert(ready.end(), batch.begin(), batch.end());
+        }
+        if (stop) return;
+    }
+}
+
+void AES256_GCM_Reservoir::Encrypt(const uint8_t* plaintext, size_t len,
+                                   const uint8_t* aad, size_t aadLen,
+                                   uint8_t* ciphertext, uint8_t iv_out[12], uint8_t tag_out[16]) {
+    size_t idx = 0;
+    bool have = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        if (len <= maxBytes && !ready.empty()) {
+            // newest first: its keystream is the most likely to still be in cache
+            idx = ready.back();
+            ready.pop_back();
+            have = true;
+            ++hits;
+        } else {
+            ++misses;
+        }
+    }
+
+    if (!have) {
+        if (!fastRandomBytes(iv_out, 12)) throw std::runtime_error("cannot generate random IV");
+        gcm->Encrypt(iv_out, 12, plaintext, len, aad, aadLen, ciphertext, tag_out);
+        return;
+    }
+
+    uint8_t* ks = &keystream[idx * entryBytes];
+    std::memcpy(iv_out, &ivs[idx * 12], 12);
+    XorBytes(ciphertext, plaintext, ks + 16, len);
+    uint8_t S[16];
+    gcm->GHASH(aad, aadLen, ciphertext, len, S);
+    for (int i = 0; i < 16; ++i) tag_out[i] = uint8_t(S[i] ^ ks[i]);
+    // an entry is never reused: wipe what was handed out, the rest is refilled
+    SecureZero(ks, 16 + len);
+
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        used.push_back(idx);
+        // wake the thread once per refill round, not on every call
+        notify = used.size() == refillAt || ready.empty();
+    }
+    if (notify) wake.notify_one();
+}
+
+AES256_GCM_Reservoir::Stats AES256_GCM_Reservoir::GetStats() const {
+    std::lock_guard<std::mutex> lk(mtx);
+    Stats s;
+    s.hits = hits;
+    s.misses = misses;
+    s.ready = ready.size();
+    return s;
+}
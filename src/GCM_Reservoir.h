@@ -0,0 +1,75 @@
+#ifndef GCM_RESERVOIR_H
+#define GCM_RESERVOIR_H
+
+#include "GCM.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Precomputed keystream for low-latency encryption of small messages under
+// one key. A background thread keeps a pool of entries, each a fresh random
+// IV with its tag mask E_K(J0) and the keystream for MaxMessageBytes().
+// Encrypt takes one entry, so the message itself only costs an XOR and
+// GHASH; the AES work happened before the data arrived.
+//
+// Every entry is used once and wiped afterwards. When no entry is ready (or
+// the message is longer than an entry), Encrypt draws an IV and runs the
+// normal AES256_GCM::Encrypt path, so callers never wait for the refill.
+class AES256_GCM_Reservoir {
+public:
+    struct Stats {
+        uint64_t hits = 0;   // served from a precomputed entry
+        uint64_t misses = 0; // reservoir empty or message too long
+        size_t ready = 0;    // entries waiting right now
+    };
+
+    // entries: pool size; maxMessageBytes: longest message an entry covers.
+    // The background thread starts filling right away.
+    explicit AES256_GCM_Reservoir(std::shared_ptr<const AES256_GCM> gcm,
+                                  size_t entries = 256, size_t maxMessageBytes = 1024);
+    // Stops the refill thread and wipes every unused entry
+    ~AES256_GCM_Reservoir();
+
+    AES256_GCM_Reservoir(const AES256_GCM_Reservoir&) = delete;
+    AES256_GCM_Reservoir& operator=(const AES256_GCM_Reservoir&) = delete;
+
+    // Encrypt under a fresh IV, written to iv_out (12 bytes). Output and tag
+    // equal gcm.Encrypt(iv_out, ...). ciphertext may equal plaintext.
+    // Thread-safe. Throws std::runtime_error if no random IV can be drawn.
+    void Encrypt(const uint8_t* plaintext, size_t len,
+                 const uint8_t* aad, size_t aadLen,
+                 uint8_t* ciphertext, uint8_t iv_out[12], uint8_t tag_out[16]);
+
+    size_t MaxMessageBytes() const { return maxBytes; }
+    Stats GetStats() const;
+
+private:
+    // Refill thread: waits until enough entries are used up, then refills
+    // them in one batch (one RNG call, one pipelined AES run per entry)
+    void RefillLoop();
+    // IV and E_K(IV || 1), E_K(IV || 2), ... into entry idx
+    void FillEntry(size_t idx, const uint8_t iv[12]);
+
+    const std::shared_ptr<const AES256_GCM> gcm;
+    const size_t maxBytes;
+    const size_t entryBytes; // mask block + keystream blocks
+    const size_t refillAt;   // wake the refill thread at this many used entries
+
+    std::vector<uint8_t> keystream; // entries * entryBytes
+    std::vector<uint8_t> ivs;       // entries * 12
+
+    mutable std::mutex mtx;
+    std::condition_variable wake;
+    std::deque<size_t> ready; // filled, newest last
+    std::deque<size_t> used;  // free for the refill thread
+    uint64_t hits = 0, misses = 0;
+    bool stop = false;
+    std::thread filler;
+};
+
+#endif
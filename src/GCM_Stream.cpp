@@ -0,0 +1,166 @@
+#include "GCM_Stream.h"
+#include "SecureZero.h"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+AES256_GCM_Stream::AES256_GCM_Stream(const AES256_GCM& gcm)
+    : gcm(gcm) {}
+
+AES256_GCM_Stream::~AES256_GCM_Stream() {
+    Wipe();
+}
+
+void AES256_GCM_Stream::Wipe() {
+    for (uint8_t* b : {J0, counter, X, partial, ks}) SecureZero(b, 16);
+    partialLen = 0;
+}
+
+void AES256_GCM_Stream::Init(const std::vector<uint8_t>& iv, Mode m) {
+    Wipe();
+    AES256_GCM::MakeJ0(iv.data(), iv.size(), J0); // throws on a bad IV length
+    mode = m;
+    phase = Phase::AAD;
+    aadLen = 0;
+    msgLen = 0;
+
+    // data starts at J0+1
+    std::memcpy(counter, J0, 16);
+    AES256_GCM::Inc32(counter);
+}
+
+void AES256_GCM_Stream::UpdateAAD(const uint8_t* aad, size_t len) {
+    if (phase != Phase::AAD) throw std::logic_error("GCM stream: AAD must come after Init and before data");
+    aadLen += len;
+    if (partialLen) {
+        size_t take = std::min(len, 16 - partialLen);
+        std::memcpy(partial + partialLen, aad, take);
+        partialLen += take;
+        aad += take;
+        len -= take;
+        if (partialLen < 16) return;
+        gcm.GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+    size_t full = len / 16;
+    gcm.GhashBlocks(X, aad, full);
+    partialLen = len % 16;
+    std::memcpy(partial, aad + full * 16, partialLen);
+}
+
+// AAD and ciphertext are padded separately, so close the AAD block first
+void AES256_GCM_Stream::FlushAAD() {
+    if (partialLen) {
+        std::memset(partial + partialLen, 0, 16 - partialLen);
+        gcm.GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+    phase = Phase::Data;
+}
+
+void AES256_GCM_Stream::Update(const uint8_t* in, uint8_t* out, size_t len) {
+    if (phase == Phase::AAD) FlushAAD();
+    if (phase != Phase::Data) throw std::logic_error("GCM stream: Update called outside a message");
+    if (len > AES256_GCM::MaxMessageBytes - msgLen) throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+    msgLen += len;
+    if (mode == Mode::Verify) {
+        HashOnly(in, len);
+        return;
+    }
+    const bool decrypt = (mode == Mode::Decrypt);
+
+    // finish the block left open by the previous call
+    if (partialLen) {
+        size_t take = std::min(len, 16 - partialLen);
+        for (size_t i = 0; i < take; ++i) {
+            uint8_t c = decrypt ? in[i] : static_cast<uint8_t>(in[i] ^ ks[partialLen + i]);
+            out[i] = static_cast<uint8_t>(in[i] ^ ks[partialLen + i]);
+            partial[partialLen + i] = c;
+        }
+        partialLen += take;
+        in += take;
+        out += take;
+        len -= take;
+        if (partialLen < 16) return;
+        gcm.GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+
+    size_t full = len / 16;
+    gcm.CryptAndHash(decrypt, counter, X, in, out, full * 16);
+    in += full * 16;
+    out += full * 16;
+    len -= full * 16;
+
+    // open a new block: keep its keystream for the next call
+    if (len) {
+        std::memset(ks, 0, 16);
+        gcm.aes.EncryptCtr32(counter, ks, ks, 16);
+        for (size_t i = 0; i < len; ++i) {
+            uint8_t c = decrypt ? in[i] : static_cast<uint8_t>(in[i] ^ ks[i]);
+            out[i] = static_cast<uint8_t>(in[i] ^ ks[i]);
+            partial[i] = c;
+        }
+        partialLen = len;
+    }
+}
+
+void AES256_GCM_Stream::Update(const uint8_t* ciphertext, size_t len) {
+    if (mode != Mode::Verify) throw std::logic_error("GCM stream: Update without output is for Verify mode");
+    Update(ciphertext, nullptr, len);
+}
+
+// Verify mode: same block buffering as Update, without the counter stream
+void AES256_GCM_Stream::HashOnly(const uint8_t* in, size_t len) {
+    if (partialLen) {
+        size_t take = std::min(len, 16 - partialLen);
+        std::memcpy(partial + partialLen, in, take);
+        partialLen += take;
+        in += take;
+        len -= take;
+        if (partialLen < 16) return;
+        gcm.GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+    size_t full = len / 16;
+    gcm.GhashBlocks(X, in, full);
+    partialLen = len % 16;
+    std::memcpy(partial, in + full * 16, partialLen);
+}
+
+void AES256_GCM_Stream::ComputeTag(uint8_t tag[16]) {
+    if (phase == Phase::AAD) FlushAAD();
+    if (phase != Phase::Data) throw std::logic_error("GCM stream: Final called outside a message");
+    if (partialLen) {
+        std::memset(partial + partialLen, 0, 16 - partialLen);
+        gcm.GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+    gcm.GhashLengths(X, aadLen, msgLen);
+
+    std::memcpy(tag, J0, 16);
+    gcm.aes.EncryptBlock(tag);
+    for (int i = 0; i < 16; ++i) tag[i] ^= X[i];
+    phase = Phase::Done;
+}
+
+void AES256_GCM_Stream::Final(std::vector<uint8_t>& tag_out) {
+    if (mode != Mode::Encrypt) throw std::logic_error("GCM stream: Final is for encryption, use FinalVerify");
+    tag_out.resize(16);
+    ComputeTag(tag_out.data());
+    Wipe();
+}
+
+void AES256_GCM_Stream::FinalVerify(const std::vector<uint8_t>& tag) {
+    if (mode == Mode::Encrypt) throw std::logic_error("GCM stream: FinalVerify is for decryption, use Final");
+    if (tag.size() != 16) throw std::invalid_argument("GCM tag must be 16 bytes");
+    uint8_t expected[16];
+    ComputeTag(expected);
+
+    // constant-time compare
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>(expected[i] ^ tag[i]);
+    std::memset(expected, 0, 16);
+    Wipe();
+    if (diff != 0) throw std::runtime_error("GCM authentication failed!");
+}
@@ -0,0 +1,74 @@
+#ifndef GCM_STREAM_H
+#define GCM_STREAM_H
+
+#include "GCM.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Incremental AES-256-GCM over a prepared AES256_GCM context, for messages
+// that never fit in memory at once. Usage:
+//   Init(iv, mode) -> UpdateAAD(...)* -> Update(...)* -> Final / FinalVerify
+// Update accepts any length and writes exactly len bytes; a partial block is
+// carried over between calls. One GCM message is limited by the 32-bit block
+// counter to 2^36 - 32 bytes (~64 GiB); Update throws past that.
+//
+// Decrypt mode hands out plaintext before the tag is checked. Callers must
+// discard everything they received if FinalVerify throws. Verify mode only
+// authenticates: Update hashes the ciphertext (no keystream, out is unused
+// and may be null), so a check costs GHASH alone.
+class AES256_GCM_Stream {
+public:
+    enum class Mode { Encrypt, Decrypt, Verify };
+
+    // gcm must outlive the stream
+    explicit AES256_GCM_Stream(const AES256_GCM& gcm);
+    ~AES256_GCM_Stream();
+
+    AES256_GCM_Stream(const AES256_GCM_Stream&) = delete;
+    AES256_GCM_Stream& operator=(const AES256_GCM_Stream&) = delete;
+
+    // Start a new message (12-byte IV); may be called again to reuse the object
+    void Init(const std::vector<uint8_t>& iv, Mode mode);
+
+    // Additional authenticated data; all of it must come before the first Update
+    void UpdateAAD(const uint8_t* aad, size_t len);
+    void UpdateAAD(const std::vector<uint8_t>& aad) { UpdateAAD(aad.data(), aad.size()); }
+
+    // Encrypt or decrypt len bytes from in to out (in may equal out)
+    void Update(const uint8_t* in, uint8_t* out, size_t len);
+    // Verify mode: absorb len bytes of ciphertext
+    void Update(const uint8_t* ciphertext, size_t len);
+
+    // Encrypt mode: finish and write the 16-byte tag
+    void Final(std::vector<uint8_t>& tag_out);
+    // Decrypt / Verify mode: finish and compare against tag (constant time);
+    // throws std::runtime_error on mismatch
+    void FinalVerify(const std::vector<uint8_t>& tag);
+
+    uint64_t AADBytes() const { return aadLen; }
+    uint64_t MessageBytes() const { return msgLen; }
+
+private:
+    enum class Phase { Idle, AAD, Data, Done };
+
+    const AES256_GCM& gcm;
+    Mode mode = Mode::Encrypt;
+    Phase phase = Phase::Idle;
+
+    uint8_t J0[16] = {0};
+    uint8_t counter[16] = {0};
+    uint8_t X[16] = {0};        // running GHASH state
+    uint8_t partial[16] = {0};  // AAD or ciphertext bytes of the unfinished block
+    uint8_t ks[16] = {0};       // keystream of the unfinished data block
+    size_t partialLen = 0;
+    uint64_t aadLen = 0;
+    uint64_t msgLen = 0;
+
+    void FlushAAD();
+    void HashOnly(const uint8_t* in, size_t len);
+    void ComputeTag(uint8_t tag[16]);
+    void Wipe();
+};
+
+#endif
@@ -0,0 +1,597 @@
+#include "GCM_VAES.h"
+#include "AES_NI.h"
+#include "CpuFeatures.h"
+#include "GCM_CLMUL.h"
+
+#if defined(AESGCM_X86)
+
+// GCC 12's AVX-512 headers build results from deliberately undefined
+// registers (_mm512_undefined_*), which -W(maybe-)uninitialized reports at
+// every inlined extract/broadcast
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+#include <immintrin.h>
+
+#define XMM_TARGET AESGCM_TARGET("pclmul,ssse3,sse4.1")
+#define V512_TARGET AESGCM_TARGET("vaes,vpclmulqdq,avx512f,avx512bw,avx2,aes,pclmul,ssse3,sse4.1")
+#define V256_TARGET AESGCM_TARGET("vaes,vpclmulqdq,avx2,aes,pclmul,ssse3,sse4.1")
+
+namespace {
+
+// Per 128-bit lane: reverses the 16 bytes of every block (see GCM_CLMUL.cpp)
+XMM_TARGET inline __m128i ByteSwapMask() {
+    return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+// The reduction of GCM_CLMUL.cpp: fold mid into lo/hi, shift the 256-bit
+// product left by one and reduce modulo x^128 + x^7 + x^2 + x + 1. Runs once
+// per 16 blocks, after the lanes have been summed.
+XMM_TARGET inline __m128i Reduce(__m128i lo, __m128i mid, __m128i hi) {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    __m128i t4 = _mm_srli_epi32(lo, 2);
+    __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+// rev[t] = H^(16 - t) byte-swapped, rev[16..19] = 0. Block j of a group of
+// m <= 16 blocks is multiplied by H^(m - j) = rev[16 - m + j], so a vector
+// load at rev + 16 - m + j gives the multipliers of blocks j, j+1, ...;
+// lanes past the end of a short group pick up zero powers.
+XMM_TARGET inline void LoadRevPowers(const uint8_t Hpow[16][16], __m128i rev[20]) {
+    for (int t = 0; t < 16; ++t)
+        rev[t] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Hpow[15 - t]), ByteSwapMask());
+    for (int t = 16; t < 20; ++t) rev[t] = _mm_setzero_si128();
+}
+
+// ---- 512-bit: four blocks per register ----
+
+// Lane-wise 128x128 carry-less products accumulated into lo/mid/hi
+V512_TARGET inline void MulAcc512(__m512i a, __m512i b, __m512i& lo, __m512i& mid, __m512i& hi) {
+    lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(a, b, 0x00));
+    hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(a, b, 0x11));
+    mid = _mm512_ternarylogic_epi64(mid, _mm512_clmulepi64_epi128(a, b, 0x01),
+                                    _mm512_clmulepi64_epi128(a, b, 0x10), 0x96); // 3-way XOR
+}
+
+// XOR of the four lanes
+V512_TARGET inline __m128i Fold512(__m512i v) {
+    __m256i t = _mm256_xor_si256(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    return _mm_xor_si128(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+}
+
+// h[k], lane i = H^(16 - 4k - i): the multipliers of blocks 4k .. 4k+3 of a group
+V512_TARGET inline void LoadHPowers512(const uint8_t Hpow[16][16], __m512i bswap, __m512i h[4]) {
+    for (int k = 0; k < 4; ++k) {
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)Hpow[15 - 4 * k]));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)Hpow[14 - 4 * k]), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)Hpow[13 - 4 * k]), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)Hpow[12 - 4 * k]), 3);
+        h[k] = _mm512_shuffle_epi8(v, bswap);
+    }
+}
+
+// Block 4k .. 4k+3 of the group at g, byte-swapped; x is folded into block 0
+#define V512_HASH_IN(g, k) _mm512_shuffle_epi8(_mm512_loadu_si512((g) + (k)), bswap)
+#define V512_HASH_IN0(g) _mm512_xor_si512(V512_HASH_IN(g, 0), _mm512_inserti32x4(_mm512_setzero_si512(), x, 0))
+
+// One 16-block GHASH group, one reduction
+V512_TARGET inline __m128i Ghash16x512(__m128i x, const __m512i* g, const __m512i h[4], __m512i bswap) {
+    __m512i lo = _mm512_setzero_si512(), mid = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+    MulAcc512(V512_HASH_IN0(g), h[0], lo, mid, hi);
+    MulAcc512(V512_HASH_IN(g, 1), h[1], lo, mid, hi);
+    MulAcc512(V512_HASH_IN(g, 2), h[2], lo, mid, hi);
+    MulAcc512(V512_HASH_IN(g, 3), h[3], lo, mid, hi);
+    return Reduce(Fold512(lo), Fold512(mid), Fold512(hi));
+}
+
+// A short group (m = 1..15 blocks at p) in one reduction; vector lanes past
+// the end are masked to zero and not read
+V512_TARGET inline __m128i GhashTail512(__m128i x, const uint8_t* p, size_t m,
+                                        const __m128i rev[20], __m512i bswap) {
+    __m512i lo = _mm512_setzero_si512(), mid = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+    const __m128i* pw = rev + 16 - m;
+    for (size_t k = 0; 4 * k < m; ++k) {
+        size_t left = m - 4 * k;
+        __mmask8 mask = left >= 4 ? __mmask8(0xff) : __mmask8((1u << (2 * left)) - 1);
+        __m512i d = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi64(mask, p + 64 * k), bswap);
+        if (k == 0) d = _mm512_xor_si512(d, _mm512_inserti32x4(_mm512_setzero_si512(), x, 0));
+        MulAcc512(d, _mm512_loadu_si512(pw + 4 * k), lo, mid, hi);
+    }
+    return Reduce(Fold512(lo), Fold512(mid), Fold512(hi));
+}
+
+// ---- 256-bit: two blocks per register ----
+
+V256_TARGET inline void MulAcc256(__m256i a, __m256i b, __m256i& lo, __m256i& mid, __m256i& hi) {
+    lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(a, b, 0x00));
+    hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(a, b, 0x11));
+    mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(a, b, 0x01));
+    mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(a, b, 0x10));
+}
+
+V256_TARGET inline __m128i Fold256(__m256i v) {
+    return _mm_xor_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+// h[k], lane i = H^(16 - 2k - i)
+V256_TARGET inline void LoadHPowers256(const uint8_t Hpow[16][16], __m256i bswap, __m256i h[8]) {
+    for (int k = 0; k < 8; ++k) {
+        __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)Hpow[15 - 2 * k]));
+        v = _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i*)Hpow[14 - 2 * k]), 1);
+        h[k] = _mm256_shuffle_epi8(v, bswap);
+    }
+}
+
+#define V256_HASH_IN(g, k) _mm256_shuffle_epi8(_mm256_loadu_si256((g) + (k)), bswap)
+#define V256_HASH_IN0(g) _mm256_xor_si256(V256_HASH_IN(g, 0), _mm256_inserti128_si256(_mm256_setzero_si256(), x, 0))
+
+V256_TARGET inline __m128i Ghash16x256(__m128i x, const __m256i* g, const __m256i h[8], __m256i bswap) {
+    __m256i lo = _mm256_setzero_si256(), mid = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    MulAcc256(V256_HASH_IN0(g), h[0], lo, mid, hi);
+    for (int k = 1; k < 8; ++k) MulAcc256(V256_HASH_IN(g, k), h[k], lo, mid, hi);
+    return Reduce(Fold256(lo), Fold256(mid), Fold256(hi));
+}
+
+V256_TARGET inline __m128i GhashTail256(__m128i x, const uint8_t* p, size_t m,
+                                        const __m128i rev[20], __m256i bswap) {
+    __m256i lo = _mm256_setzero_si256(), mid = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    const __m128i* pw = rev + 16 - m;
+    for (size_t k = 0; 2 * k < m; ++k) {
+        __m256i d = m - 2 * k >= 2
+            ? _mm256_loadu_si256((const __m256i*)(p + 32 * k))
+            : _mm256_inserti128_si256(_mm256_setzero_si256(), _mm_loadu_si128((const __m128i*)(p + 32 * k)), 0);
+        d = _mm256_shuffle_epi8(d, bswap);
+        if (k == 0) d = _mm256_xor_si256(d, _mm256_inserti128_si256(_mm256_setzero_si256(), x, 0));
+        MulAcc256(d, _mm256_loadu_si256((const __m256i*)(pw + 2 * k)), lo, mid, hi);
+    }
+    return Reduce(Fold256(lo), Fold256(mid), Fold256(hi));
+}
+
+} // namespace
+
+V512_TARGET
+void VPCLMUL512_GhashBlocks(const uint8_t Hpow[16][16], uint8_t X[16],
+                            const uint8_t* data, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        const __m512i bswap = _mm512_broadcast_i32x4(ByteSwapMask());
+        __m512i h[4];
+        LoadHPowers512(Hpow, bswap, h);
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), ByteSwapMask());
+        const __m512i* g = reinterpret_cast<const __m512i*>(data);
+        for (size_t i = 0; i < wide; i += 16, g += 4) x = Ghash16x512(x, g, h, bswap);
+        _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, ByteSwapMask()));
+    }
+    if (nblocks > wide) CLMUL_GhashBlocks(Hpow, X, data + wide * 16, nblocks - wide);
+}
+
+V256_TARGET
+void VPCLMUL256_GhashBlocks(const uint8_t Hpow[16][16], uint8_t X[16],
+                            const uint8_t* data, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        const __m256i bswap = _mm256_broadcastsi128_si256(ByteSwapMask());
+        __m256i h[8];
+        LoadHPowers256(Hpow, bswap, h);
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), ByteSwapMask());
+        const __m256i* g = reinterpret_cast<const __m256i*>(data);
+        for (size_t i = 0; i < wide; i += 16, g += 8) x = Ghash16x256(x, g, h, bswap);
+        _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, ByteSwapMask()));
+    }
+    if (nblocks > wide) CLMUL_GhashBlocks(Hpow, X, data + wide * 16, nblocks - wide);
+}
+
+// Streams are independent, so the short multiply/reduce chains of
+// consecutive streams overlap without explicit interleaving
+V512_TARGET
+void VPCLMUL512_GhashMulti(const uint8_t Hpow[16][16], size_t streams,
+                           const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]) {
+    const __m512i bswap = _mm512_broadcast_i32x4(ByteSwapMask());
+    __m128i rev[20];
+    LoadRevPowers(Hpow, rev);
+    __m512i h[4];
+    for (int k = 0; k < 4; ++k) h[k] = _mm512_loadu_si512(rev + 4 * k);
+    for (size_t s = 0; s < streams; ++s) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X[s]), ByteSwapMask());
+        const uint8_t* p = data[s];
+        size_t m = nblocks[s];
+        for (; m >= 16; m -= 16, p += 256) x = Ghash16x512(x, reinterpret_cast<const __m512i*>(p), h, bswap);
+        if (m) x = GhashTail512(x, p, m, rev, bswap);
+        _mm_storeu_si128((__m128i*)X[s], _mm_shuffle_epi8(x, ByteSwapMask()));
+    }
+}
+
+V256_TARGET
+void VPCLMUL256_GhashMulti(const uint8_t Hpow[16][16], size_t streams,
+                           const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]) {
+    const __m256i bswap = _mm256_broadcastsi128_si256(ByteSwapMask());
+    __m128i rev[20];
+    LoadRevPowers(Hpow, rev);
+    __m256i h[8];
+    for (int k = 0; k < 8; ++k) h[k] = _mm256_loadu_si256((const __m256i*)(rev + 2 * k));
+    for (size_t s = 0; s < streams; ++s) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X[s]), ByteSwapMask());
+        const uint8_t* p = data[s];
+        size_t m = nblocks[s];
+        for (; m >= 16; m -= 16, p += 256) x = Ghash16x256(x, reinterpret_cast<const __m256i*>(p), h, bswap);
+        if (m) x = GhashTail256(x, p, m, rev, bswap);
+        _mm_storeu_si128((__m128i*)X[s], _mm_shuffle_epi8(x, ByteSwapMask()));
+    }
+}
+
+// ---- stitched CTR + GHASH, 16 blocks per iteration ----
+//
+// As in GCM_CLMUL.cpp the counters are kept byte-reversed so a 32-bit lane
+// add is inc32; every 128-bit lane holds its own counter. Encrypt hashes the
+// previous group while the AES rounds of the current one run; decrypt
+// hashes the group it is decrypting (loaded before any store, so in == out
+// is safe).
+
+#define V512_COUNTERS()                                                          \
+    __m512i b0 = _mm512_xor_si512(_mm512_shuffle_epi8(ctr, bswap), rk[0]);       \
+    __m512i b1 = _mm512_xor_si512(_mm512_shuffle_epi8(_mm512_add_epi32(ctr, step4), bswap), rk[0]);  \
+    __m512i b2 = _mm512_xor_si512(_mm512_shuffle_epi8(_mm512_add_epi32(ctr, step8), bswap), rk[0]);  \
+    __m512i b3 = _mm512_xor_si512(_mm512_shuffle_epi8(_mm512_add_epi32(ctr, step12), bswap), rk[0]); \
+    ctr = _mm512_add_epi32(ctr, step16)
+
+#define V512_AESENC(k)                                                           \
+    b0 = _mm512_aesenc_epi128(b0, k); b1 = _mm512_aesenc_epi128(b1, k);          \
+    b2 = _mm512_aesenc_epi128(b2, k); b3 = _mm512_aesenc_epi128(b3, k)
+
+#define V512_AESENCLAST(k)                                                       \
+    b0 = _mm512_aesenclast_epi128(b0, k); b1 = _mm512_aesenclast_epi128(b1, k);  \
+    b2 = _mm512_aesenclast_epi128(b2, k); b3 = _mm512_aesenclast_epi128(b3, k)
+
+// Rounds 1..4 each carry one 4-block multiply of the group at g
+#define V512_ROUNDS_WITH_GHASH(g)                                                \
+    V512_AESENC(rk[1]); MulAcc512(V512_HASH_IN0(g), h[0], lo, mid, hi);          \
+    V512_AESENC(rk[2]); MulAcc512(V512_HASH_IN(g, 1), h[1], lo, mid, hi);        \
+    V512_AESENC(rk[3]); MulAcc512(V512_HASH_IN(g, 2), h[2], lo, mid, hi);        \
+    V512_AESENC(rk[4]); MulAcc512(V512_HASH_IN(g, 3), h[3], lo, mid, hi);        \
+    for (int r = 5; r < rounds; ++r) { V512_AESENC(rk[r]); }                     \
+    V512_AESENCLAST(rk[rounds])
+
+#define V512_STORE()                                                             \
+    _mm512_storeu_si512(dst + 0, _mm512_xor_si512(b0, _mm512_loadu_si512(src + 0))); \
+    _mm512_storeu_si512(dst + 1, _mm512_xor_si512(b1, _mm512_loadu_si512(src + 1))); \
+    _mm512_storeu_si512(dst + 2, _mm512_xor_si512(b2, _mm512_loadu_si512(src + 2))); \
+    _mm512_storeu_si512(dst + 3, _mm512_xor_si512(b3, _mm512_loadu_si512(src + 3)))
+
+// Loads the key schedule, H powers, X and counter (lanes = counter + 0..3)
+#define V512_SETUP()                                                             \
+    const __m512i bswap = _mm512_broadcast_i32x4(ByteSwapMask());                \
+    __m512i rk[15];                                                              \
+    for (int r = 0; r <= rounds; ++r)                                            \
+        rk[r] = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r)); \
+    __m512i h[4];                                                                \
+    LoadHPowers512(Hpow, bswap, h);                                              \
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), ByteSwapMask()); \
+    __m512i ctr = _mm512_add_epi32(                                              \
+        _mm512_broadcast_i32x4(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)counter), ByteSwapMask())), \
+        _mm512_set_epi32(0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));       \
+    const __m512i step4 = _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4); \
+    const __m512i step8 = _mm512_add_epi32(step4, step4);                        \
+    const __m512i step12 = _mm512_add_epi32(step8, step4);                       \
+    const __m512i step16 = _mm512_add_epi32(step8, step8);                       \
+    const __m512i* src = reinterpret_cast<const __m512i*>(in);                   \
+    __m512i* dst = reinterpret_cast<__m512i*>(out)
+
+// Lane 0 holds the next unused counter
+#define V512_FINISH()                                                            \
+    _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, ByteSwapMask()));          \
+    _mm_storeu_si128((__m128i*)counter, _mm_shuffle_epi8(_mm512_castsi512_si128(ctr), ByteSwapMask()))
+
+V512_TARGET
+void VAES512_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        V512_SETUP();
+        {
+            // first group has no previous ciphertext to hash
+            V512_COUNTERS();
+            for (int r = 1; r < rounds; ++r) { V512_AESENC(rk[r]); }
+            V512_AESENCLAST(rk[rounds]);
+            V512_STORE();
+            src += 4;
+            dst += 4;
+        }
+        for (size_t done = 16; done < wide; done += 16) {
+            const __m512i* prev = dst - 4;
+            __m512i lo = _mm512_setzero_si512(), mid = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+            V512_COUNTERS();
+            V512_ROUNDS_WITH_GHASH(prev);
+            V512_STORE();
+            x = Reduce(Fold512(lo), Fold512(mid), Fold512(hi));
+            src += 4;
+            dst += 4;
+        }
+        x = Ghash16x512(x, dst - 4, h, bswap); // last group
+        V512_FINISH();
+    }
+    if (nblocks > wide)
+        CLMUL_AESNI_GcmEncrypt(roundKeys, rounds, Hpow, counter, X, in + wide * 16, out + wide * 16,
+                               nblocks - wide);
+}
+
+V512_TARGET
+void VAES512_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        V512_SETUP();
+        for (size_t done = 0; done < wide; done += 16) {
+            __m512i lo = _mm512_setzero_si512(), mid = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+            V512_COUNTERS();
+            V512_ROUNDS_WITH_GHASH(src);
+            V512_STORE();
+            x = Reduce(Fold512(lo), Fold512(mid), Fold512(hi));
+            src += 4;
+            dst += 4;
+        }
+        V512_FINISH();
+    }
+    if (nblocks > wide)
+        CLMUL_AESNI_GcmDecrypt(roundKeys, rounds, Hpow, counter, X, in + wide * 16, out + wide * 16,
+                               nblocks - wide);
+}
+
+// 256-bit: eight registers of two blocks; lane pair j = counter + 2j, 2j+1
+#define V256_COUNTERS()                                                          \
+    __m256i b0 = _mm256_xor_si256(_mm256_shuffle_epi8(ctr, bswap), rk[0]);       \
+    __m256i b1 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step2), bswap), rk[0]);  \
+    __m256i b2 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step4), bswap), rk[0]);  \
+    __m256i b3 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step6), bswap), rk[0]);  \
+    __m256i b4 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step8), bswap), rk[0]);  \
+    __m256i b5 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step10), bswap), rk[0]); \
+    __m256i b6 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step12), bswap), rk[0]); \
+    __m256i b7 = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_add_epi32(ctr, step14), bswap), rk[0]); \
+    ctr = _mm256_add_epi32(ctr, step16)
+
+#define V256_AESENC(k)                                                           \
+    b0 = _mm256_aesenc_epi128(b0, k); b1 = _mm256_aesenc_epi128(b1, k);          \
+    b2 = _mm256_aesenc_epi128(b2, k); b3 = _mm256_aesenc_epi128(b3, k);          \
+    b4 = _mm256_aesenc_epi128(b4, k); b5 = _mm256_aesenc_epi128(b5, k);          \
+    b6 = _mm256_aesenc_epi128(b6, k); b7 = _mm256_aesenc_epi128(b7, k)
+
+#define V256_AESENCLAST(k)                                                       \
+    b0 = _mm256_aesenclast_epi128(b0, k); b1 = _mm256_aesenclast_epi128(b1, k);  \
+    b2 = _mm256_aesenclast_epi128(b2, k); b3 = _mm256_aesenclast_epi128(b3, k);  \
+    b4 = _mm256_aesenclast_epi128(b4, k); b5 = _mm256_aesenclast_epi128(b5, k);  \
+    b6 = _mm256_aesenclast_epi128(b6, k); b7 = _mm256_aesenclast_epi128(b7, k)
+
+// Rounds 1..8 each carry one 2-block multiply of the group at g
+#define V256_ROUNDS_WITH_GHASH(g)                                                \
+    V256_AESENC(rk[1]); MulAcc256(V256_HASH_IN0(g), h[0], lo, mid, hi);          \
+    V256_AESENC(rk[2]); MulAcc256(V256_HASH_IN(g, 1), h[1], lo, mid, hi);        \
+    V256_AESENC(rk[3]); MulAcc256(V256_HASH_IN(g, 2), h[2], lo, mid, hi);        \
+    V256_AESENC(rk[4]); MulAcc256(V256_HASH_IN(g, 3), h[3], lo, mid, hi);        \
+    V256_AESENC(rk[5]); MulAcc256(V256_HASH_IN(g, 4), h[4], lo, mid, hi);        \
+    V256_AESENC(rk[6]); MulAcc256(V256_HASH_IN(g, 5), h[5], lo, mid, hi);        \
+    V256_AESENC(rk[7]); MulAcc256(V256_HASH_IN(g, 6), h[6], lo, mid, hi);        \
+    V256_AESENC(rk[8]); MulAcc256(V256_HASH_IN(g, 7), h[7], lo, mid, hi);        \
+    for (int r = 9; r < rounds; ++r) { V256_AESENC(rk[r]); }                     \
+    V256_AESENCLAST(rk[rounds])
+
+#define V256_STORE()                                                             \
+    _mm256_storeu_si256(dst + 0, _mm256_xor_si256(b0, _mm256_loadu_si256(src + 0))); \
+    _mm256_storeu_si256(dst + 1, _mm256_xor_si256(b1, _mm256_loadu_si256(src + 1))); \
+    _mm256_storeu_si256(dst + 2, _mm256_xor_si256(b2, _mm256_loadu_si256(src + 2))); \
+    _mm256_storeu_si256(dst + 3, _mm256_xor_si256(b3, _mm256_loadu_si256(src + 3))); \
+    _mm256_storeu_si256(dst + 4, _mm256_xor_si256(b4, _mm256_loadu_si256(src + 4))); \
+    _mm256_storeu_si256(dst + 5, _mm256_xor_si256(b5, _mm256_loadu_si256(src + 5))); \
+    _mm256_storeu_si256(dst + 6, _mm256_xor_si256(b6, _mm256_loadu_si256(src + 6))); \
+    _mm256_storeu_si256(dst + 7, _mm256_xor_si256(b7, _mm256_loadu_si256(src + 7)))
+
+#define V256_SETUP()                                                             \
+    const __m256i bswap = _mm256_broadcastsi128_si256(ByteSwapMask());           \
+    __m256i rk[15];                                                              \
+    for (int r = 0; r <= rounds; ++r)                                            \
+        rk[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r)); \
+    __m256i h[8];                                                                \
+    LoadHPowers256(Hpow, bswap, h);                                              \
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)X), ByteSwapMask()); \
+    __m256i ctr = _mm256_add_epi32(                                              \
+        _mm256_broadcastsi128_si256(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)counter), ByteSwapMask())), \
+        _mm256_set_epi32(0, 0, 0, 1, 0, 0, 0, 0));                               \
+    const __m256i step2 = _mm256_set_epi32(0, 0, 0, 2, 0, 0, 0, 2);              \
+    const __m256i step4 = _mm256_add_epi32(step2, step2);                        \
+    const __m256i step6 = _mm256_add_epi32(step4, step2);                        \
+    const __m256i step8 = _mm256_add_epi32(step4, step4);                        \
+    const __m256i step10 = _mm256_add_epi32(step8, step2);                       \
+    const __m256i step12 = _mm256_add_epi32(step8, step4);                       \
+    const __m256i step14 = _mm256_add_epi32(step8, step6);                       \
+    const __m256i step16 = _mm256_add_epi32(step8, step8);                       \
+    const __m256i* src = reinterpret_cast<const __m256i*>(in);                   \
+    __m256i* dst = reinterpret_cast<__m256i*>(out)
+
+#define V256_FINISH()                                                            \
+    _mm_storeu_si128((__m128i*)X, _mm_shuffle_epi8(x, ByteSwapMask()));          \
+    _mm_storeu_si128((__m128i*)counter, _mm_shuffle_epi8(_mm256_castsi256_si128(ctr), ByteSwapMask()))
+
+V256_TARGET
+void VAES256_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        V256_SETUP();
+        {
+            V256_COUNTERS();
+            for (int r = 1; r < rounds; ++r) { V256_AESENC(rk[r]); }
+            V256_AESENCLAST(rk[rounds]);
+            V256_STORE();
+            src += 8;
+            dst += 8;
+        }
+        for (size_t done = 16; done < wide; done += 16) {
+            const __m256i* prev = dst - 8;
+            __m256i lo = _mm256_setzero_si256(), mid = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+            V256_COUNTERS();
+            V256_ROUNDS_WITH_GHASH(prev);
+            V256_STORE();
+            x = Reduce(Fold256(lo), Fold256(mid), Fold256(hi));
+            src += 8;
+            dst += 8;
+        }
+        x = Ghash16x256(x, dst - 8, h, bswap);
+        V256_FINISH();
+    }
+    if (nblocks > wide)
+        CLMUL_AESNI_GcmEncrypt(roundKeys, rounds, Hpow, counter, X, in + wide * 16, out + wide * 16,
+                               nblocks - wide);
+}
+
+V256_TARGET
+void VAES256_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        V256_SETUP();
+        for (size_t done = 0; done < wide; done += 16) {
+            __m256i lo = _mm256_setzero_si256(), mid = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+            V256_COUNTERS();
+            V256_ROUNDS_WITH_GHASH(src);
+            V256_STORE();
+            x = Reduce(Fold256(lo), Fold256(mid), Fold256(hi));
+            src += 8;
+            dst += 8;
+        }
+        V256_FINISH();
+    }
+    if (nblocks > wide)
+        CLMUL_AESNI_GcmDecrypt(roundKeys, rounds, Hpow, counter, X, in + wide * 16, out + wide * 16,
+                               nblocks - wide);
+}
+
+// ---- ECB over gathered counter blocks, 16 per iteration ----
+
+V512_TARGET
+void VAES512_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                           const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        __m512i rk[15];
+        for (int r = 0; r <= rounds; ++r)
+            rk[r] = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r));
+        const __m512i* src = reinterpret_cast<const __m512i*>(in);
+        __m512i* dst = reinterpret_cast<__m512i*>(out);
+        for (size_t done = 0; done < wide; done += 16, src += 4, dst += 4) {
+            __m512i b0 = _mm512_xor_si512(_mm512_loadu_si512(src + 0), rk[0]);
+            __m512i b1 = _mm512_xor_si512(_mm512_loadu_si512(src + 1), rk[0]);
+            __m512i b2 = _mm512_xor_si512(_mm512_loadu_si512(src + 2), rk[0]);
+            __m512i b3 = _mm512_xor_si512(_mm512_loadu_si512(src + 3), rk[0]);
+            for (int r = 1; r < rounds; ++r) { V512_AESENC(rk[r]); }
+            V512_AESENCLAST(rk[rounds]);
+            _mm512_storeu_si512(dst + 0, b0);
+            _mm512_storeu_si512(dst + 1, b1);
+            _mm512_storeu_si512(dst + 2, b2);
+            _mm512_storeu_si512(dst + 3, b3);
+        }
+    }
+    if (nblocks > wide) AESNI_EncryptBlocks(roundKeys, rounds, in + wide * 16, out + wide * 16, nblocks - wide);
+}
+
+V256_TARGET
+void VAES256_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                           const uint8_t* in, uint8_t* out, size_t nblocks) {
+    size_t wide = nblocks & ~size_t(15);
+    if (wide) {
+        __m256i rk[15];
+        for (int r = 0; r <= rounds; ++r)
+            rk[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r));
+        const __m256i* src = reinterpret_cast<const __m256i*>(in);
+        __m256i* dst = reinterpret_cast<__m256i*>(out);
+        for (size_t done = 0; done < wide; done += 16, src += 8, dst += 8) {
+            __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256(src + 0), rk[0]);
+            __m256i b1 = _mm256_xor_si256(_mm256_loadu_si256(src + 1), rk[0]);
+            __m256i b2 = _mm256_xor_si256(_mm256_loadu_si256(src + 2), rk[0]);
+            __m256i b3 = _mm256_xor_si256(_mm256_loadu_si256(src + 3), rk[0]);
+            __m256i b4 = _mm256_xor_si256(_mm256_loadu_si256(src + 4), rk[0]);
+            __m256i b5 = _mm256_xor_si256(_mm256_loadu_si256(src + 5), rk[0]);
+            __m256i b6 = _mm256_xor_si256(_mm256_loadu_si256(src + 6), rk[0]);
+            __m256i b7 = _mm256_xor_si256(_mm256_loadu_si256(src + 7), rk[0]);
+            for (int r = 1; r < rounds; ++r) { V256_AESENC(rk[r]); }
+            V256_AESENCLAST(rk[rounds]);
+            _mm256_storeu_si256(dst + 0, b0);
+            _mm256_storeu_si256(dst + 1, b1);
+            _mm256_storeu_si256(dst + 2, b2);
+            _mm256_storeu_si256(dst + 3, b3);
+            _mm256_storeu_si256(dst + 4, b4);
+            _mm256_storeu_si256(dst + 5, b5);
+            _mm256_storeu_si256(dst + 6, b6);
+            _mm256_storeu_si256(dst + 7, b7);
+        }
+    }
+    if (nblocks > wide) AESNI_EncryptBlocks(roundKeys, rounds, in + wide * 16, out + wide * 16, nblocks - wide);
+}
+
+#undef V512_HASH_IN
+#undef V512_HASH_IN0
+#undef V512_COUNTERS
+#undef V512_AESENC
+#undef V512_AESENCLAST
+#undef V512_ROUNDS_WITH_GHASH
+#undef V512_STORE
+#undef V512_SETUP
+#undef V512_FINISH
+#undef V256_HASH_IN
+#undef V256_HASH_IN0
+#undef V256_COUNTERS
+#undef V256_AESENC
+#undef V256_AESENCLAST
+#undef V256_ROUNDS_WITH_GHASH
+#undef V256_STORE
+#undef V256_SETUP
+#undef V256_FINISH
+
+#else // !AESGCM_X86
+
+void VPCLMUL512_GhashBlocks(const uint8_t[16][16], uint8_t[16], const uint8_t*, size_t) {}
+void VPCLMUL256_GhashBlocks(const uint8_t[16][16], uint8_t[16], const uint8_t*, size_t) {}
+void VPCLMUL512_GhashMulti(const uint8_t[16][16], size_t, const uint8_t* const*, const size_t*, uint8_t (*)[16]) {}
+void VPCLMUL256_GhashMulti(const uint8_t[16][16], size_t, const uint8_t* const*, const size_t*, uint8_t (*)[16]) {}
+void VAES512_GcmEncrypt(const uint8_t*, int, const uint8_t[16][16], uint8_t[16], uint8_t[16],
+                        const uint8_t*, uint8_t*, size_t) {}
+void VAES512_GcmDecrypt(const uint8_t*, int, const uint8_t[16][16], uint8_t[16], uint8_t[16],
+                        const uint8_t*, uint8_t*, size_t) {}
+void VAES256_GcmEncrypt(const uint8_t*, int, const uint8_t[16][16], uint8_t[16], uint8_t[16],
+                        const uint8_t*, uint8_t*, size_t) {}
+void VAES256_GcmDecrypt(const uint8_t*, int, const uint8_t[16][16], uint8_t[16], uint8_t[16],
+                        const uint8_t*, uint8_t*, size_t) {}
+void VAES512_EncryptBlocks(const uint8_t*, int, const uint8_t*, uint8_t*, size_t) {}
+void VAES256_EncryptBlocks(const uint8_t*, int, const uint8_t*, uint8_t*, size_t) {}
+
+#endif
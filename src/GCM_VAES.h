@@ -0,0 +1,55 @@
+#ifndef GCM_VAES_H
+#define GCM_VAES_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Wide x86 GCM kernels: VAES + VPCLMULQDQ on 512-bit ZMM (4 blocks per
+// instruction, AVX-512F/BW) or 256-bit YMM (2 blocks per instruction,
+// AVX2 - Zen 3 and Alder Lake cores without AVX-512). Same value layout and
+// counter contract as GCM_CLMUL.h; results are bit-identical to the
+// CLMUL_* / AESNI_* kernels.
+//
+// Each iteration runs 16 counter blocks and one 16-block GHASH: the blocks
+// are multiplied by H^16..H^1 held as 4-lane (2-lane) H-power vectors, the
+// lanes are summed and a single reduction closes the group. Hpow[i] holds
+// H^(i+1). The last nblocks % 16 blocks go through the 128-bit kernels.
+// Callers must check GetCpuFeatures() (vaes, vpclmul and avx512 or avx2).
+
+// X = GHASH_H(X, data) over nblocks full blocks (as CLMUL_GhashBlocks)
+void VPCLMUL512_GhashBlocks(const uint8_t Hpow[16][16], uint8_t X[16],
+                            const uint8_t* data, size_t nblocks);
+void VPCLMUL256_GhashBlocks(const uint8_t Hpow[16][16], uint8_t X[16],
+                            const uint8_t* data, size_t nblocks);
+
+// Independent streams (as CLMUL_GhashMulti): X[s] absorbs nblocks[s] blocks
+// from data[s]. A stream's last nblocks % 16 blocks are one short wide group
+// (zero-padded lanes) rather than a 128-bit tail, so records of a few
+// blocks stay on the wide multiplier too.
+void VPCLMUL512_GhashMulti(const uint8_t Hpow[16][16], size_t streams,
+                           const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]);
+void VPCLMUL256_GhashMulti(const uint8_t Hpow[16][16], size_t streams,
+                           const uint8_t* const* data, const size_t* nblocks, uint8_t (*X)[16]);
+
+// Stitched CTR + GHASH (as CLMUL_AESNI_GcmEncrypt / GcmDecrypt); in may equal out
+void VAES512_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks);
+void VAES512_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks);
+void VAES256_GcmEncrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks);
+void VAES256_GcmDecrypt(const uint8_t* roundKeys, int rounds, const uint8_t Hpow[16][16],
+                        uint8_t counter[16], uint8_t X[16],
+                        const uint8_t* in, uint8_t* out, size_t nblocks);
+
+// ECB over independent blocks (as AESNI_EncryptBlocks, in may equal out);
+// encrypts the J0 and counter blocks gathered by the batch API
+void VAES512_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                           const uint8_t* in, uint8_t* out, size_t nblocks);
+void VAES256_EncryptBlocks(const uint8_t* roundKeys, int rounds,
+                           const uint8_t* in, uint8_t* out, size_t nblocks);
+
+#endif
@@ -1,14 +1,112 @@
 #include "GMAC.h"
+#include "SecureZero.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
 
 AES256_GMAC::AES256_GMAC(const std::vector<uint8_t>& key) 
-    : gcm(key) {} 
+    : gcm(std::make_shared<const AES256_GCM>(key)) {} 
+
+AES256_GMAC::AES256_GMAC(std::shared_ptr<const AES256_GCM> gcm)
+    : gcm(std::move(gcm))
+{
+    if (!this->gcm) throw std::invalid_argument("GMAC needs a GCM context");
+}
+
+AES256_GMAC::~AES256_GMAC() {
+    Wipe();
+}
+
+void AES256_GMAC::Wipe() {
+    SecureZero(mask, sizeof(mask));
+    SecureZero(X, sizeof(X));
+    SecureZero(partial, sizeof(partial));
+    partialLen = 0;
+    total = 0;
+    active = false;
+}
 
 std::vector<uint8_t> AES256_GMAC::GenerateTag(
     const std::vector<uint8_t>& iv,
-    const std::vector<uint8_t>& aad)
+    const std::vector<uint8_t>& aad) const
 {
-    std::vector<uint8_t> empty_plaintext;
-    std::vector<uint8_t> tag;
-    gcm.Encrypt(iv, empty_plaintext, aad, tag);
+    std::vector<uint8_t> tag(16);
+    GenerateTag(iv.data(), iv.size(), aad.data(), aad.size(), tag.data());
     return tag;
 }
+
+void AES256_GMAC::Tag(const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadLen,
+                      ThreadPool* pool, uint8_t tag_out[16]) const {
+    uint8_t J0[16];
+    AES256_GCM::MakeJ0(iv, ivLen, J0);
+    uint8_t S[16] = {0};
+    size_t nblocks = aadLen / 16;
+    if (pool) gcm->ParallelGhashBlocks(S, aad, nblocks, *pool);
+    else gcm->GhashBlocks(S, aad, nblocks);
+    gcm->GhashPadded(S, aad + nblocks * 16, aadLen - nblocks * 16);
+    gcm->GhashLengths(S, aadLen, 0);
+    gcm->aes.EncryptBlock(J0);
+    for (int i = 0; i < 16; ++i) tag_out[i] = J0[i] ^ S[i];
+}
+
+void AES256_GMAC::GenerateTag(const uint8_t* iv, size_t ivLen,
+                              const uint8_t* aad, size_t aadLen, uint8_t tag_out[16]) const {
+    Tag(iv, ivLen, aad, aadLen, nullptr, tag_out);
+}
+
+void AES256_GMAC::GenerateTagParallel(const uint8_t* iv, size_t ivLen,
+                                      const uint8_t* aad, size_t aadLen, uint8_t tag_out[16],
+                                      ThreadPool& pool) const {
+    Tag(iv, ivLen, aad, aadLen, &pool, tag_out);
+}
+
+bool AES256_GMAC::VerifyTag(const uint8_t* iv, size_t ivLen,
+                            const uint8_t* aad, size_t aadLen, const uint8_t tag[16],
+                            ThreadPool* pool) const {
+    uint8_t expect[16];
+    Tag(iv, ivLen, aad, aadLen, pool, expect);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= static_cast<uint8_t>(expect[i] ^ tag[i]);
+    return diff == 0;
+}
+
+void AES256_GMAC::Init(const uint8_t* iv, size_t ivLen, ThreadPool* pool) {
+    Wipe();
+    AES256_GCM::MakeJ0(iv, ivLen, mask); // throws on a bad IV length
+    gcm->aes.EncryptBlock(mask);
+    this->pool = pool;
+    active = true;
+}
+
+void AES256_GMAC::Update(const uint8_t* data, size_t len) {
+    if (!active) throw std::logic_error("GMAC: Update called outside a message");
+    total += len;
+    if (partialLen) {
+        size_t take = std::min(16 - partialLen, len);
+        std::memcpy(partial + partialLen, data, take);
+        partialLen += take;
+        data += take;
+        len -= take;
+        if (partialLen < 16) return;
+        gcm->GhashBlocks(X, partial, 1);
+        partialLen = 0;
+    }
+    size_t nblocks = len / 16;
+    if (pool) gcm->ParallelGhashBlocks(X, data, nblocks, *pool);
+    else gcm->GhashBlocks(X, data, nblocks);
+    data += nblocks * 16;
+    len -= nblocks * 16;
+    if (len) {
+        std::memcpy(partial, data, len);
+        partialLen = len;
+    }
+}
+
+void AES256_GMAC::Final(uint8_t tag_out[16]) {
+    if (!active) throw std::logic_error("GMAC: Final called outside a message");
+    gcm->GhashPadded(X, partial, partialLen);
+    gcm->GhashLengths(X, total, 0);
+    for (int i = 0; i < 16; ++i) tag_out[i] = X[i] ^ mask[i];
+    Wipe();
+}
@@ -3,18 +3,68 @@
 
 #include "AES_256.h"
 #include "GCM.h"
+#include "ThreadPool.h"
+#include <memory>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
 
+// GMAC: AES-GCM with empty plaintext, i.e. a tag over the AAD only. Hashes
+// straight through GHASH (no GCTR, no allocation). Large inputs can be
+// split over a thread pool: each segment is hashed from zero and the
+// partials are folded with powers of H, so the tag is identical to the
+// serial one. The AAD can also be fed incrementally (Init/Update/Final),
+// e.g. a multi-GB signature file read in chunks.
 class AES256_GMAC {
 public:
     AES256_GMAC(const std::vector<uint8_t>& key);
+    // Reuse a ready context (e.g. from AES256_GCM_Cache) instead of running key setup
+    explicit AES256_GMAC(std::shared_ptr<const AES256_GCM> gcm);
+    // Wipes the streaming state
+    ~AES256_GMAC();
+
     std::vector<uint8_t> GenerateTag(
         const std::vector<uint8_t>& iv,
-        const std::vector<uint8_t>& aad);
+        const std::vector<uint8_t>& aad) const;
+
+    // One shot; ivLen must be 12. Same tag as AES256_GCM::Encrypt with an
+    // empty plaintext.
+    void GenerateTag(const uint8_t* iv, size_t ivLen,
+                     const uint8_t* aad, size_t aadLen, uint8_t tag_out[16]) const;
+    // Inputs of at least AES256_GCM::ParallelMinBytes are hashed by every
+    // pool thread; the tag matches GenerateTag
+    void GenerateTagParallel(const uint8_t* iv, size_t ivLen,
+                             const uint8_t* aad, size_t aadLen, uint8_t tag_out[16],
+                             ThreadPool& pool = ThreadPool::Shared()) const;
+    // Constant-time comparison against tag; pool = nullptr hashes serially
+    bool VerifyTag(const uint8_t* iv, size_t ivLen,
+                   const uint8_t* aad, size_t aadLen, const uint8_t tag[16],
+                   ThreadPool* pool = nullptr) const;
+
+    // Streaming: Init -> Update* -> Final. Update takes any length (a
+    // partial block is carried over); with a pool, the full blocks of large
+    // Updates are hashed in parallel. Init may be called again to restart.
+    void Init(const uint8_t* iv, size_t ivLen, ThreadPool* pool = nullptr);
+    void Update(const uint8_t* data, size_t len);
+    void Final(uint8_t tag_out[16]);
+    uint64_t Bytes() const { return total; }
 
 private:
-    AES256_GCM gcm;
+    std::shared_ptr<const AES256_GCM> gcm;
+
+    // tag = GHASH ^ E_K(J0); GHASH over aad only
+    void Tag(const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadLen,
+             ThreadPool* pool, uint8_t tag_out[16]) const;
+    void Wipe();
+
+    // streaming state
+    uint8_t mask[16] = {0};    // E_K(J0)
+    uint8_t X[16] = {0};       // GHASH state
+    uint8_t partial[16] = {0}; // unfinished block
+    size_t partialLen = 0;
+    uint64_t total = 0;
+    bool active = false;
+    ThreadPool* pool = nullptr;
 };
 
 #endif
@@ -0,0 +1,267 @@
+#include "Instrument.h"
+#include <sstream>
+
+#ifdef AESGCM_INSTRUMENT
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+const char* GcmPhaseName(GcmPhase p) {
+    switch (p) {
+    case GcmPhase::AesKeySchedule: return "aes_key_schedule";
+    case GcmPhase::GhashKeySetup: return "ghash_key_setup";
+    case GcmPhase::Gctr: return "gctr";
+    case GcmPhase::Ghash: return "ghash";
+    case GcmPhase::CryptAndHash: return "crypt_and_hash";
+    case GcmPhase::GaloisMultiply: return "galois_multiply";
+    }
+    return "unknown";
+}
+
+std::string GcmStatsJson(const GcmStats& s) {
+    std::ostringstream o;
+    o << "{\"enabled\":" << (s.enabled ? "true" : "false")
+      << ",\"perf_counters\":" << (s.perfCounters ? "true" : "false")
+      << ",\"allocations\":" << s.allocations << ",\"allocated_bytes\":" << s.allocatedBytes
+      << ",\"phases\":{";
+    for (size_t i = 0; i < GcmPhaseCount; ++i) {
+        const GcmPhaseStats& p = s.phase[i];
+        o << (i ? "," : "") << "\"" << GcmPhaseName(GcmPhase(i)) << "\":{\"calls\":" << p.calls
+          << ",\"ns\":" << p.nanoseconds << ",\"bytes\":" << p.bytes << ",\"blocks\":" << p.blocks
+          << ",\"multiplies\":" << p.multiplies << ",\"cycles\":" << p.cycles
+          << ",\"instructions\":" << p.instructions << "}";
+    }
+    o << "}}";
+    return o.str();
+}
+
+#ifdef AESGCM_INSTRUMENT
+
+namespace {
+
+enum Field { kCalls, kNs, kBytes, kBlocks, kMuls, kCycles, kInstr, kFields };
+
+// One per thread. Only the owning thread writes; relaxed atomics let the
+// snapshot read them without a data race.
+struct ThreadCounters {
+    std::atomic<uint64_t> v[GcmPhaseCount][kFields];
+    std::atomic<uint64_t> allocs{0};
+    std::atomic<uint64_t> allocBytes{0};
+    int depth = 0;       // phases open on this thread
+    int perfFd = -1;     // group leader (cycles); instructions is its member
+    int perfMember = -1;
+    bool perfTried = false;
+
+    ThreadCounters() {
+        for (auto& row : v)
+            for (auto& x : row) x.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct Registry {
+    std::mutex m;
+    std::vector<ThreadCounters*> live;
+    uint64_t retired[GcmPhaseCount][kFields] = {};
+    uint64_t retiredAllocs = 0;
+    uint64_t retiredAllocBytes = 0;
+    std::atomic<bool> perfOk{false};
+};
+
+// Never destroyed: thread_local slots of late threads may still fold into it
+Registry& GetRegistry() {
+    static Registry* r = new Registry;
+    return *r;
+}
+
+void ClosePerf(ThreadCounters& c) {
+#ifdef __linux__
+    if (c.perfMember >= 0) ::close(c.perfMember);
+    if (c.perfFd >= 0) ::close(c.perfFd);
+#endif
+    c.perfFd = c.perfMember = -1;
+}
+
+struct ThreadSlot {
+    ThreadCounters* c = new ThreadCounters;
+
+    ThreadSlot() {
+        Registry& r = GetRegistry();
+        std::lock_guard<std::mutex> lk(r.m);
+        r.live.push_back(c);
+    }
+    ~ThreadSlot() {
+        Registry& r = GetRegistry();
+        {
+            std::lock_guard<std::mutex> lk(r.m);
+            for (size_t p = 0; p < GcmPhaseCount; ++p)
+                for (size_t f = 0; f < kFields; ++f) r.retired[p][f] += c->v[p][f].load(std::memory_order_relaxed);
+            r.retiredAllocs += c->allocs.load(std::memory_order_relaxed);
+            r.retiredAllocBytes += c->allocBytes.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < r.live.size(); ++i) {
+                if (r.live[i] == c) {
+                    r.live[i] = r.live.back();
+                    r.live.pop_back();
+                    break;
+                }
+            }
+        }
+        ClosePerf(*c);
+        delete c;
+    }
+};
+
+ThreadCounters& Local() {
+    thread_local ThreadSlot slot;
+    return *slot.c;
+}
+
+void Add(std::atomic<uint64_t>& x, uint64_t n) {
+    x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+uint64_t NowNs() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef __linux__
+int OpenCounter(uint64_t config, int group) {
+    perf_event_attr a{};
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config;
+    a.exclude_kernel = 1; // works at perf_event_paranoid <= 2
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_GROUP;
+    return int(::syscall(SYS_perf_event_open, &a, 0 /* this thread */, -1 /* any CPU */, group,
+                         PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+// Opens this thread's cycle/instruction group on first use
+bool PerfReady(ThreadCounters& c) {
+#ifdef __linux__
+    if (!c.perfTried) {
+        c.perfTried = true;
+        c.perfFd = OpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (c.perfFd >= 0) c.perfMember = OpenCounter(PERF_COUNT_HW_INSTRUCTIONS, c.perfFd);
+        if (c.perfMember < 0) ClosePerf(c);
+        else GetRegistry().perfOk.store(true, std::memory_order_relaxed);
+    }
+    return c.perfFd >= 0;
+#else
+    (void)c;
+    return false;
+#endif
+}
+
+// cycles, instructions of the calling thread so far
+bool ReadPerf(const ThreadCounters& c, uint64_t out[2]) {
+#ifdef __linux__
+    struct { uint64_t nr; uint64_t v[2]; } g;
+    if (::read(c.perfFd, &g, sizeof(g)) != ssize_t(sizeof(g)) || g.nr != 2) return false;
+    out[0] = g.v[0];
+    out[1] = g.v[1];
+    return true;
+#else
+    (void)c;
+    (void)out;
+    return false;
+#endif
+}
+
+} // namespace
+
+GcmPhaseScope::GcmPhaseScope(GcmPhase p, uint64_t bytes, uint64_t blocks, uint64_t multiplies)
+    : phase(p), startPerf{0, 0}
+{
+    ThreadCounters& c = Local();
+    std::atomic<uint64_t>* row = c.v[size_t(p)];
+    Add(row[kCalls], 1);
+    Add(row[kBytes], bytes);
+    Add(row[kBlocks], blocks);
+    Add(row[kMuls], multiplies);
+    outermost = c.depth++ == 0;
+    perf = outermost && PerfReady(c) && ReadPerf(c, startPerf);
+    startNs = NowNs();
+}
+
+GcmPhaseScope::~GcmPhaseScope() {
+    uint64_t ns = NowNs() - startNs;
+    ThreadCounters& c = Local();
+    std::atomic<uint64_t>* row = c.v[size_t(phase)];
+    Add(row[kNs], ns);
+    uint64_t end[2];
+    if (perf && ReadPerf(c, end)) {
+        Add(row[kCycles], end[0] - startPerf[0]);
+        Add(row[kInstr], end[1] - startPerf[1]);
+    }
+    --c.depth;
+}
+
+void GcmCountAlloc(size_t bytes) {
+    ThreadCounters& c = Local();
+    Add(c.allocs, 1);
+    Add(c.allocBytes, bytes);
+}
+
+GcmStats GcmStatsSnapshot() {
+    Registry& r = GetRegistry();
+    uint64_t sum[GcmPhaseCount][kFields];
+    GcmStats s;
+    s.enabled = true;
+    std::lock_guard<std::mutex> lk(r.m);
+    for (size_t p = 0; p < GcmPhaseCount; ++p)
+        for (size_t f = 0; f < kFields; ++f) sum[p][f] = r.retired[p][f];
+    s.allocations = r.retiredAllocs;
+    s.allocatedBytes = r.retiredAllocBytes;
+    for (ThreadCounters* c : r.live) {
+        for (size_t p = 0; p < GcmPhaseCount; ++p)
+            for (size_t f = 0; f < kFields; ++f) sum[p][f] += c->v[p][f].load(std::memory_order_relaxed);
+        s.allocations += c->allocs.load(std::memory_order_relaxed);
+        s.allocatedBytes += c->allocBytes.load(std::memory_order_relaxed);
+    }
+    for (size_t p = 0; p < GcmPhaseCount; ++p) {
+        GcmPhaseStats& ps = s.phase[p];
+        ps.calls = sum[p][kCalls];
+        ps.nanoseconds = sum[p][kNs];
+        ps.bytes = sum[p][kBytes];
+        ps.blocks = sum[p][kBlocks];
+        ps.multiplies = sum[p][kMuls];
+        ps.cycles = sum[p][kCycles];
+        ps.instructions = sum[p][kInstr];
+    }
+    s.perfCounters = r.perfOk.load(std::memory_order_relaxed);
+    return s;
+}
+
+// Live threads' counters are owned by those threads; a reset racing with
+// their updates may lose a few increments
+void GcmStatsReset() {
+    Registry& r = GetRegistry();
+    std::lock_guard<std::mutex> lk(r.m);
+    for (auto& row : r.retired)
+        for (auto& x : row) x = 0;
+    r.retiredAllocs = r.retiredAllocBytes = 0;
+    for (ThreadCounters* c : r.live) {
+        for (auto& row : c->v)
+            for (auto& x : row) x.store(0, std::memory_order_relaxed);
+        c->allocs.store(0, std::memory_order_relaxed);
+        c->allocBytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+GcmStats GcmStatsSnapshot() { return GcmStats(); }
+void GcmStatsReset() {}
+
+#endif
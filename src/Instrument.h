@@ -0,0 +1,89 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Optional counters on the crypto hot paths, compiled out unless the build
+// defines AESGCM_INSTRUMENT (-DAESGCM_INSTRUMENT). Without it the
+// AESGCM_PHASE / AESGCM_ALLOC macros expand to nothing and the snapshot is
+// all zeros with enabled = false.
+//
+// Each phase records calls, wall nanoseconds, bytes, blocks and GF(2^128)
+// multiplies. Times and counts are inclusive: a phase that runs inside
+// another (GHASH inside the non-stitched CryptAndHash, GaloisMultiply inside
+// key setup) is counted in both. On Linux the cycle and instruction counters
+// of perf_event_open (user space only) are read around the outermost phase
+// of each thread, so nested phases are not double-counted there; where perf
+// is unavailable (container, perf_event_paranoid) those two stay 0.
+//
+// Counters are per thread (no shared cache line on the hot path) and summed
+// by GcmStatsSnapshot; totals of finished threads are kept.
+
+enum class GcmPhase { AesKeySchedule, GhashKeySetup, Gctr, Ghash, CryptAndHash, GaloisMultiply };
+constexpr size_t GcmPhaseCount = 6;
+
+struct GcmPhaseStats {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+    uint64_t blocks = 0;       // AES blocks (GCTR, CryptAndHash) or GHASH blocks
+    uint64_t multiplies = 0;   // GF(2^128) multiplications
+    uint64_t cycles = 0;       // perf counters, outermost phase only
+    uint64_t instructions = 0;
+};
+
+struct GcmStats {
+    bool enabled = false;      // built with AESGCM_INSTRUMENT
+    bool perfCounters = false; // perf_event_open worked on at least one thread
+    GcmPhaseStats phase[GcmPhaseCount];
+    uint64_t allocations = 0;  // heap buffers made by the vector API and fresh BufferPool blocks
+    uint64_t allocatedBytes = 0;
+};
+
+// snake_case name used in the JSON dump ("aes_key_schedule", ...)
+const char* GcmPhaseName(GcmPhase p);
+
+// Sum over all threads; approximate while other threads are still running
+GcmStats GcmStatsSnapshot();
+void GcmStatsReset();
+
+// One JSON object: {"enabled":..,"perf_counters":..,"allocations":..,
+// "allocated_bytes":..,"phases":{"<name>":{"calls":..,"ns":..,"bytes":..,
+// "blocks":..,"multiplies":..,"cycles":..,"instructions":..},..}}
+std::string GcmStatsJson(const GcmStats& s);
+inline std::string GcmStatsJson() { return GcmStatsJson(GcmStatsSnapshot()); }
+
+#ifdef AESGCM_INSTRUMENT
+
+// Times one phase from construction to destruction
+class GcmPhaseScope {
+public:
+    GcmPhaseScope(GcmPhase p, uint64_t bytes, uint64_t blocks, uint64_t multiplies);
+    ~GcmPhaseScope();
+    GcmPhaseScope(const GcmPhaseScope&) = delete;
+    GcmPhaseScope& operator=(const GcmPhaseScope&) = delete;
+
+private:
+    GcmPhase phase;
+    uint64_t startNs;
+    uint64_t startPerf[2];
+    bool outermost;
+    bool perf;
+};
+
+void GcmCountAlloc(size_t bytes);
+
+#define AESGCM_PHASE(phase, bytes, blocks, multiplies) \
+    GcmPhaseScope aesgcm_phase_scope_(phase, bytes, blocks, multiplies)
+#define AESGCM_ALLOC(bytes) GcmCountAlloc(bytes)
+
+#else
+
+#define AESGCM_PHASE(phase, bytes, blocks, multiplies) ((void)0)
+#define AESGCM_ALLOC(bytes) ((void)0)
+
+#endif
+
+#endif
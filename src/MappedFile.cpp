@@ -0,0 +1,193 @@
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+[[noreturn]] void throwErrno(const std::string& what, const std::string& path) {
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+}
+
+MappedFile MappedFile::OpenRead(const std::string& path) {
+    MappedFile m;
+    m.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m.fd < 0) throwErrno("cannot open", path);
+    struct stat st;
+    if (::fstat(m.fd, &st) != 0) throwErrno("cannot stat", path);
+    m.size = static_cast<size_t>(st.st_size);
+    if (m.size == 0) return m; // mmap rejects empty ranges
+    void* p = ::mmap(nullptr, m.size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, m.fd, 0);
+    if (p == MAP_FAILED) throwErrno("cannot mmap", path);
+    m.data = static_cast<uint8_t*>(p);
+    ::madvise(p, m.size, MADV_SEQUENTIAL);
+    return m;
+}
+
+MappedFile MappedFile::CreateWrite(const std::string& path, size_t size) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) throwErrno("cannot create", path);
+    return MapWritable(fd, path, size);
+}
+
+MappedFile MappedFile::CreateReplacing(const std::string& path, size_t size) {
+    std::string tmp = path + ".XXXXXX";
+    int fd = ::mkostemp(&tmp[0], O_CLOEXEC); // 0600, unique in the same directory
+    if (fd < 0) throwErrno("cannot create", tmp);
+    try {
+        MappedFile m = MapWritable(fd, tmp, size);
+        m.tempPath = tmp;
+        m.finalPath = path;
+        return m;
+    } catch (...) {
+        ::unlink(tmp.c_str());
+        throw;
+    }
+}
+
+// Takes ownership of fd
+MappedFile MappedFile::MapWritable(int fd, const std::string& path, size_t size) {
+    MappedFile m;
+    m.fd = fd;
+    m.writable = true;
+    m.size = size;
+    if (size == 0) return m;
+    // reserve blocks up front so a full disk fails here, not as SIGBUS later
+    int err = ::posix_fallocate(m.fd, 0, static_cast<off_t>(size));
+    if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+        errno = err;
+        throwErrno("cannot allocate", path);
+    }
+    if (err != 0 && ::ftruncate(m.fd, static_cast<off_t>(size)) != 0) throwErrno("cannot resize", path);
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m.fd, 0);
+    if (p == MAP_FAILED) throwErrno("cannot mmap", path);
+    m.data = static_cast<uint8_t*>(p);
+    ::madvise(p, size, MADV_SEQUENTIAL);
+    return m;
+}
+
+MappedFile::~MappedFile() {
+    if (data) ::munmap(data, size);
+    if (fd >= 0) ::close(fd);
+    if (!tempPath.empty()) ::unlink(tempPath.c_str()); // never closed: discard
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)),
+      fd(std::exchange(other.fd, -1)), writable(other.writable),
+      tempPath(std::move(other.tempPath)), finalPath(std::move(other.finalPath)) {
+    other.tempPath.clear();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        this->~MappedFile();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        fd = std::exchange(other.fd, -1);
+        writable = other.writable;
+        tempPath = std::move(other.tempPath);
+        finalPath = std::move(other.finalPath);
+        other.tempPath.clear();
+    }
+    return *this;
+}
+
+void MappedFile::Close() {
+    bool failed = false;
+    if (data) {
+        if (writable && ::msync(data, size, MS_SYNC) != 0) failed = true;
+        ::munmap(data, size);
+        data = nullptr;
+    }
+    if (fd >= 0) {
+        if (::close(fd) != 0) failed = true;
+        fd = -1;
+    }
+    size = 0;
+    std::string tmp = std::exchange(tempPath, std::string());
+    if (failed) {
+        if (!tmp.empty()) ::unlink(tmp.c_str());
+        throw std::runtime_error("write-back of mapped file failed");
+    }
+    if (!tmp.empty() && ::rename(tmp.c_str(), finalPath.c_str()) != 0) {
+        int e = errno;
+        ::unlink(tmp.c_str());
+        errno = e;
+        throwErrno("cannot rename into", finalPath);
+    }
+}
+
+#else
+
+MappedFile MappedFile::OpenRead(const std::string&) {
+    throw std::runtime_error("memory-mapped file I/O is only available on Linux");
+}
+
+MappedFile MappedFile::CreateWrite(const std::string&, size_t) {
+    throw std::runtime_error("memory-mapped file I/O is only available on Linux");
+}
+
+MappedFile MappedFile::CreateReplacing(const std::string&, size_t) {
+    throw std::runtime_error("memory-mapped file I/O is only available on Linux");
+}
+
+MappedFile::~MappedFile() {}
+MappedFile::MappedFile(MappedFile&&) noexcept {}
+MappedFile& MappedFile::operator=(MappedFile&&) noexcept { return *this; }
+void MappedFile::Close() {}
+
+#endif
+
+void EncryptFileMapped(const AES256_GCM& gcm,
+                       const std::string& inPath, const std::string& outPath,
+                       const std::vector<uint8_t>& salt, const std::vector<uint8_t>& iv,
+                       const uint8_t* aad, size_t aadLen, uint8_t tag_out[16],
+                       ThreadPool* pool)
+{
+    MappedFile in = MappedFile::OpenRead(inPath);
+    if (in.Size() > AES256_GCM::MaxMessageBytes) {
+        throw std::length_error("GCM message exceeds 2^36 - 32 bytes");
+    }
+    size_t prefixLen = salt.size() + iv.size();
+    // a throw before Close() discards the temporary
+    MappedFile out = MappedFile::CreateReplacing(outPath, prefixLen + in.Size());
+    uint8_t* dst = out.Data();
+    if (!salt.empty()) std::memcpy(dst, salt.data(), salt.size()); // prefix SALT
+    std::memcpy(dst + salt.size(), iv.data(), iv.size());         // prefix IV
+    if (pool) {
+        gcm.EncryptParallel(iv.data(), iv.size(), in.Data(), in.Size(), aad, aadLen,
+                            dst + prefixLen, tag_out, *pool);
+    } else {
+        gcm.Encrypt(iv.data(), iv.size(), in.Data(), in.Size(), aad, aadLen, dst + prefixLen, tag_out);
+    }
+    out.Close();
+}
+
+void DecryptFileMapped(const AES256_GCM& gcm,
+                       const std::string& inPath, const std::string& outPath,
+                       size_t saltLen, const uint8_t* aad, size_t aadLen,
+                       const uint8_t tag[16],
+                       ThreadPool* pool)
+{
+    MappedFile in = MappedFile::OpenRead(inPath);
+    size_t prefixLen = saltLen + 12;
+    if (in.Size() < prefixLen) throw std::runtime_error("ciphertext file too short: " + inPath);
+    const uint8_t* iv = in.Data() + saltLen;
+    size_t len = in.Size() - prefixLen;
+    // unverified plaintext never carries outPath's name: a bad tag (Decrypt
+    // zeroes the mapped plaintext before throwing) discards the temporary
+    MappedFile out = MappedFile::CreateReplacing(outPath, len);
+    if (pool) gcm.DecryptParallel(iv, 12, in.Data() + prefixLen, len, aad, aadLen, tag, out.Data(), *pool);
+    else gcm.Decrypt(iv, 12, in.Data() + prefixLen, len, aad, aadLen, tag, out.Data());
+    out.Close();
+}
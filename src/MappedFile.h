@@ -0,0 +1,78 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "GCM.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Zero-copy file path (Linux): input and output are mmapped, AES-GCM reads
+// the input pages and writes ciphertext straight into the page cache of the
+// output, so each page is read once and written once. On other platforms
+// every function throws std::runtime_error.
+//
+// File layout matches the GUI: [Salt(16)] || IV(12) || ciphertext, tag kept
+// separately (tag_output.bin).
+
+// RAII mapping of a whole file
+class MappedFile {
+public:
+    // Read-only mapping of an existing file (size may be 0)
+    static MappedFile OpenRead(const std::string& path);
+    // Create/truncate path to exactly size bytes and map it read-write
+    static MappedFile CreateWrite(const std::string& path, size_t size);
+    // As CreateWrite, but into a new file beside path (path + ".XXXXXX").
+    // Close() renames it over path; if the mapping is dropped without a
+    // successful Close() the temporary is unlinked and path is untouched.
+    static MappedFile CreateReplacing(const std::string& path, size_t size);
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // msync (for writable maps) and unmap, then rename a CreateReplacing
+    // temporary into place; throws if the write-back or rename fails
+    void Close();
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+    bool writable = false;
+    std::string tempPath;  // CreateReplacing: file being written
+    std::string finalPath; // ... and the name it gets on Close()
+
+    static MappedFile MapWritable(int fd, const std::string& path, size_t size);
+};
+
+// Encrypt inPath into outPath as prefix || ciphertext, where prefix is
+// salt (may be empty) || iv; the 16-byte tag goes to tag_out. Large files are
+// split across pool; pool = nullptr keeps the work on the calling thread
+// (callers that already run one file per thread). The output is written to a
+// temporary and renamed over outPath only when complete; on failure an
+// existing outPath is left as it was.
+void EncryptFileMapped(const AES256_GCM& gcm,
+                       const std::string& inPath, const std::string& outPath,
+                       const std::vector<uint8_t>& salt, const std::vector<uint8_t>& iv,
+                       const uint8_t* aad, size_t aadLen, uint8_t tag_out[16],
+                       ThreadPool* pool = &ThreadPool::Shared());
+
+// Decrypt a file written by EncryptFileMapped (saltLen is 0 or 16; the IV is
+// read from the file). Plaintext goes to a temporary beside outPath that is
+// renamed into place only after the tag has verified; on a bad tag the
+// temporary is removed (outPath, e.g. the original plaintext, is not touched)
+// and std::runtime_error is thrown.
+void DecryptFileMapped(const AES256_GCM& gcm,
+                       const std::string& inPath, const std::string& outPath,
+                       size_t saltLen, const uint8_t* aad, size_t aadLen,
+                       const uint8_t tag[16],
+                       ThreadPool* pool = &ThreadPool::Shared());
+
+#endif
@@ -0,0 +1,210 @@
+#include "Nonce.h"
+#include "AES_256.h"
+#include "SecureZero.h"
+#include "Utils.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Keystream per refill (after the 32 bytes that become the next key)
+const size_t kBufferBytes = 4096;
+// Output between reseeds from the OS
+const uint64_t kReseedBytes = uint64_t(1) << 20;
+
+// Bumped in every forked child, so a child never replays its parent's stream
+std::atomic<unsigned> g_forkGeneration{0};
+
+#ifndef _WIN32
+void OnFork() { g_forkGeneration.fetch_add(1, std::memory_order_relaxed); }
+#endif
+
+void InstallForkHandler() {
+#ifndef _WIN32
+    static std::once_flag once;
+    std::call_once(once, [] { pthread_atfork(nullptr, nullptr, OnFork); });
+#endif
+}
+
+class ThreadRng {
+public:
+    ~ThreadRng() { Wipe(); }
+
+    bool Fill(uint8_t* out, size_t n) {
+        while (n > 0) {
+            if (pos == kBufferBytes || gen != g_forkGeneration.load(std::memory_order_relaxed)) {
+                if (!Refill()) return false;
+            }
+            size_t take = n < kBufferBytes - pos ? n : kBufferBytes - pos;
+            std::memcpy(out, buf + pos, take);
+            // served bytes are erased right away
+            SecureZero(buf + pos, take);
+            pos += take;
+            out += take;
+            n -= take;
+        }
+        return true;
+    }
+
+private:
+    std::unique_ptr<AES256> aes;
+    uint8_t buf[kBufferBytes];
+    size_t pos = kBufferBytes;
+    uint64_t sinceReseed = kReseedBytes;
+    unsigned gen = 0;
+
+    bool Refill() {
+        unsigned g = g_forkGeneration.load(std::memory_order_relaxed);
+        if (!aes || sinceReseed >= kReseedBytes || gen != g) {
+            InstallForkHandler();
+            std::vector<uint8_t> seed = randomBytes(AES256::KeyBytes);
+            if (seed.size() != AES256::KeyBytes) return false;
+            aes.reset(new AES256(seed));
+            SecureZero(seed.data(), seed.size());
+            sinceReseed = 0;
+            gen = g;
+        }
+        // key || buffer = AES-CTR(key, 0, 1, 2, ...); the old key is dropped
+        uint8_t block[AES256::KeyBytes + kBufferBytes];
+        uint8_t counter[16] = {0};
+        std::memset(block, 0, sizeof(block));
+        aes->EncryptCtr32(counter, block, block, sizeof(block));
+        aes.reset(new AES256(std::vector<uint8_t>(block, block + AES256::KeyBytes)));
+        std::memcpy(buf, block + AES256::KeyBytes, kBufferBytes);
+        SecureZero(block, sizeof(block));
+        pos = 0;
+        sinceReseed += kBufferBytes;
+        return true;
+    }
+
+    void Wipe() {
+        SecureZero(buf, sizeof(buf));
+        aes.reset();
+    }
+};
+
+// Counter values from here on are never handed out: leaves room for 2^32
+// concurrent fetch_adds past the end without wrapping to 0
+const uint64_t kCounterEnd = UINT64_MAX - (uint64_t(1) << 32);
+
+// State file: "AGIV" | version 1 | 0,0,0 | prefix(4) | next unreserved counter (uint64 BE)
+const size_t kStateBytes = 20;
+
+void StoreBe64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+}
+
+uint64_t LoadBe64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+} // namespace
+
+bool fastRandomBytes(uint8_t* out, size_t n) {
+    thread_local ThreadRng rng;
+    if (rng.Fill(out, n)) return true;
+    std::memset(out, 0, n);
+    return false;
+}
+
+CounterIV::CounterIV() {
+    if (!fastRandomBytes(prefix, sizeof(prefix))) throw std::runtime_error("cannot generate random IV prefix");
+}
+
+CounterIV::CounterIV(const uint8_t p[4]) {
+    std::memcpy(prefix, p, sizeof(prefix));
+}
+
+CounterIV::CounterIV(const std::string& path, uint64_t reserve)
+    : statePath(path), reserveBlock(reserve)
+{
+    if (reserveBlock == 0) throw std::invalid_argument("IV reservation block must be non-zero");
+    uint64_t mark = 0;
+    if (FILE* f = std::fopen(statePath.c_str(), "rb")) {
+        uint8_t s[kStateBytes + 1];
+        size_t got = std::fread(s, 1, sizeof(s), f);
+        std::fclose(f);
+        if (got != kStateBytes || std::memcmp(s, "AGIV", 4) != 0 || s[4] != 1)
+            throw std::runtime_error("malformed IV state file " + statePath);
+        std::memcpy(prefix, s + 8, 4);
+        mark = LoadBe64(s + 12);
+        if (mark > kCounterEnd) mark = kCounterEnd;
+    } else if (!fastRandomBytes(prefix, sizeof(prefix))) {
+        throw std::runtime_error("cannot generate random IV prefix");
+    }
+    // everything below mark may have been used by an earlier run
+    next.store(mark);
+    limit.store(mark);
+    Reserve(mark);
+}
+
+void CounterIV::Next(uint8_t iv[12]) {
+    uint64_t c = next.fetch_add(1, std::memory_order_relaxed);
+    if (c >= kCounterEnd) {
+        next.store(kCounterEnd, std::memory_order_relaxed); // stay exhausted, never wrap
+        throw std::length_error("IV counter exhausted for this key");
+    }
+    if (c >= limit.load(std::memory_order_acquire)) Reserve(c);
+    std::memcpy(iv, prefix, 4);
+    StoreBe64(iv + 4, c);
+}
+
+void CounterIV::Reserve(uint64_t c) {
+    std::lock_guard<std::mutex> lk(persistMutex);
+    uint64_t lim = limit.load(std::memory_order_relaxed);
+    if (c < lim) return; // another thread already extended the window
+    uint64_t mark = reserveBlock < kCounterEnd - c ? c + reserveBlock : kCounterEnd;
+    WriteState(mark);
+    limit.store(mark, std::memory_order_release);
+}
+
+void CounterIV::WriteState(uint64_t mark) {
+    uint8_t s[kStateBytes] = {'A', 'G', 'I', 'V', 1, 0, 0, 0};
+    std::memcpy(s + 8, prefix, 4);
+    StoreBe64(s + 12, mark);
+
+    // write a temp file, flush it to disk, then atomically replace the state
+    std::string tmp = statePath + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) throw std::runtime_error("cannot write IV state " + tmp);
+    bool ok = std::fwrite(s, 1, sizeof(s), f) == sizeof(s) && std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = std::fclose(f) == 0 && ok;
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp.c_str(), statePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok && std::rename(tmp.c_str(), statePath.c_str()) == 0;
+    if (ok) {
+        // the rename itself must survive a crash too
+        size_t slash = statePath.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : statePath.substr(0, slash + 1);
+        int dfd = open(dir.c_str(), O_RDONLY);
+        if (dfd >= 0) {
+            fsync(dfd);
+            close(dfd);
+        }
+    }
+#endif
+    if (!ok) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("cannot write IV state " + statePath);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef NONCE_H
+#define NONCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Nonce generation for high message rates.
+//
+// fastRandomBytes: per-thread AES-256-CTR generator with fast key erasure.
+// Each refill encrypts a buffer of keystream and keeps its first 32 bytes as
+// the next key, so earlier output cannot be recomputed from a later state.
+// The generator reseeds from randomBytes (the OS RNG) every ReseedBytes of
+// output and in a forked child. A 12-byte IV costs a memcpy from the buffer
+// instead of a syscall; no locks, no shared state.
+//
+// CounterIV: deterministic 96-bit GCM IVs, prefix(4) || counter(uint64 BE).
+// Unique by construction for one key, so the number of messages is not
+// bounded by the birthday limit of random IVs (SP 800-38D 8.2.1).
+
+// n bytes from the calling thread's generator; false if the OS RNG cannot
+// seed it (out is then zeroed)
+bool fastRandomBytes(uint8_t* out, size_t n);
+
+// One instance per key, shared by every thread that encrypts under that
+// key. Next() is one atomic fetch_add. With a state file, counter values are
+// reserved in windows of reserveBlock. The end of a window is written
+// durably (fsync + atomic rename) before any value inside it is handed out.
+// After a crash or restart the generator resumes past the saved end, so it
+// may skip values but never repeats one. A forked child must not keep
+// using its parent's instance (both would continue from the same counter).
+class CounterIV {
+public:
+    static constexpr uint64_t DefaultReserve = uint64_t(1) << 20;
+
+    // In memory only: random prefix, counter from 0. For keys that never
+    // outlive the process.
+    CounterIV();
+    // Explicit prefix (e.g. a sender id when several parties share a key)
+    explicit CounterIV(const uint8_t prefix[4]);
+    // Persistent: resumes from statePath, or creates it with a random prefix.
+    // Throws std::runtime_error if the file is malformed or cannot be written.
+    explicit CounterIV(const std::string& statePath, uint64_t reserveBlock = DefaultReserve);
+
+    CounterIV(const CounterIV&) = delete;
+    CounterIV& operator=(const CounterIV&) = delete;
+
+    // Fresh IV into iv (12 bytes). Thread-safe; takes a lock only when a
+    // persistent window runs out. Throws std::length_error once the 64-bit
+    // counter is exhausted (rotate the key).
+    void Next(uint8_t iv[12]);
+
+    const uint8_t* Prefix() const { return prefix; }
+    // Values handed out so far plus those skipped at start-up
+    uint64_t Issued() const { return next.load(std::memory_order_relaxed); }
+
+private:
+    uint8_t prefix[4] = {0};
+    std::atomic<uint64_t> next{0};
+    std::atomic<uint64_t> limit{UINT64_MAX}; // first value not reserved on disk (no file: never reached)
+
+    std::string statePath; // empty: nothing persisted
+    uint64_t reserveBlock = DefaultReserve;
+    std::mutex persistMutex;
+
+    // Slow path of Next: extends the durable window until it covers c
+    void Reserve(uint64_t c);
+    void WriteState(uint64_t mark);
+};
+
+#endif
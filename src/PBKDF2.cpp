@@ -0,0 +1,416 @@
+#include "PBKDF2.h"
+#include "CpuFeatures.h"
+#include "SecureZero.h"
+#include <cstring>
+#include <stdexcept>
+
+#if defined(AESGCM_X86)
+#include <immintrin.h>
+#endif
+
+// Lane engines use GCC/Clang vector extensions: one source for the scalar,
+// 4-lane and 8-lane loops, compiled per ISA through AESGCM_TARGET wrappers
+#if defined(AESGCM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PBKDF2_LANES 1
+#endif
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Message words 8..15 of every iteration block: a 32-byte digest follows a
+// 64-byte HMAC pad, so the message is always 96 bytes (768 bits)
+const uint32_t kDigestPadBit = 0x80000000;
+const uint32_t kDigestMsgBits = 768;
+
+inline uint32_t load_be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+// A macro, not a function: a 32-byte vector returned by value from a
+// function without AVX enabled trips GCC's ABI warning (-Wpsabi)
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// FIPS 180-4 compression of one block; w is the 16-word message and is
+// overwritten by the rolling schedule. V is uint32_t (one message) or a
+// vector of 32-bit lanes (one message per lane).
+template <class V>
+AESGCM_INLINE void Compress(V s[8], V w[16]) {
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            V w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+            w[i & 15] += (ROTR(w2, 17) ^ ROTR(w2, 19) ^ (w2 >> 10)) + w[(i - 7) & 15] +
+                         (ROTR(w15, 7) ^ ROTR(w15, 18) ^ (w15 >> 3));
+        }
+        V t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i & 15];
+        V t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+}
+
+// count PBKDF2 iterations from U_1: u = HMAC(P, u) (two compressions from
+// the precomputed inner/outer pad states), t ^= u
+template <class V>
+AESGCM_INLINE void Iterate(const V is[8], const V os[8], V u[8], V t[8], uint32_t count) {
+    const V zero = V();
+    for (uint32_t it = 0; it < count; ++it) {
+        V w[16], s[8];
+        for (int k = 0; k < 8; ++k) {
+            w[k] = u[k];
+            s[k] = is[k];
+        }
+        w[8] = zero + kDigestPadBit;
+        for (int k = 9; k < 15; ++k) w[k] = zero;
+        w[15] = zero + kDigestMsgBits;
+        Compress(s, w);
+
+        for (int k = 0; k < 8; ++k) {
+            w[k] = s[k];
+            u[k] = os[k];
+        }
+        w[8] = zero + kDigestPadBit;
+        for (int k = 9; k < 15; ++k) w[k] = zero;
+        w[15] = zero + kDigestMsgBits;
+        Compress(u, w);
+
+        for (int k = 0; k < 8; ++k) t[k] ^= u[k];
+    }
+}
+
+#undef ROTR
+
+// Byte-oriented SHA-256 over the portable compression: HMAC key hashing and
+// the salt || INT(i) message of U_1, both outside the hot loop
+struct Sha256 {
+    uint32_t s[8];
+    uint8_t buf[64];
+    size_t used = 0;
+    uint64_t total = 0;
+
+    // from a given chaining state that has already absorbed prefixBytes (a
+    // multiple of 64): continues an HMAC from its pad state
+    Sha256(const uint32_t state[8] = IV, uint64_t prefixBytes = 0) : total(prefixBytes) {
+        std::memcpy(s, state, sizeof(s));
+    }
+    ~Sha256() {
+        SecureZero(s, sizeof(s));
+        SecureZero(buf, sizeof(buf));
+    }
+
+    void Block(const uint8_t* p) {
+        uint32_t w[16];
+        for (int k = 0; k < 16; ++k) w[k] = load_be32(p + 4 * k);
+        Compress(s, w);
+        SecureZero(w, sizeof(w));
+    }
+
+    void Update(const uint8_t* p, size_t n) {
+        if (n == 0) return;
+        total += n;
+        if (used) {
+            size_t take = n < 64 - used ? n : 64 - used;
+            std::memcpy(buf + used, p, take);
+            used += take;
+            p += take;
+            n -= take;
+            if (used < 64) return;
+            Block(buf);
+            used = 0;
+        }
+        for (; n >= 64; p += 64, n -= 64) Block(p);
+        std::memcpy(buf, p, n);
+        used = n;
+    }
+
+    void Final(uint32_t out[8]) {
+        uint64_t bits = total * 8;
+        buf[used++] = 0x80;
+        if (used > 56) {
+            std::memset(buf + used, 0, 64 - used);
+            Block(buf);
+            used = 0;
+        }
+        std::memset(buf + used, 0, 56 - used);
+        for (int k = 0; k < 8; ++k) buf[56 + k] = static_cast<uint8_t>(bits >> (56 - 8 * k));
+        Block(buf);
+        std::memcpy(out, s, sizeof(s));
+    }
+};
+
+// Inner and outer HMAC states after the 64-byte key pads
+void HmacPads(const uint8_t* pass, size_t passLen, uint32_t is[8], uint32_t os[8]) {
+    uint8_t key[64] = {0};
+    if (passLen > 64) {
+        uint32_t d[8];
+        Sha256 h;
+        h.Update(pass, passLen);
+        h.Final(d);
+        for (int k = 0; k < 8; ++k) store_be32(key + 4 * k, d[k]);
+        SecureZero(d, sizeof(d));
+    } else if (passLen) {
+        std::memcpy(key, pass, passLen);
+    }
+    uint8_t pad[64];
+    for (int i = 0; i < 64; ++i) pad[i] = key[i] ^ 0x36;
+    Sha256 in;
+    in.Block(pad);
+    std::memcpy(is, in.s, 32);
+    for (int i = 0; i < 64; ++i) pad[i] = key[i] ^ 0x5c;
+    Sha256 out;
+    out.Block(pad);
+    std::memcpy(os, out.s, 32);
+    SecureZero(key, sizeof(key));
+    SecureZero(pad, sizeof(pad));
+}
+
+// U_1 = HMAC(P, salt || INT(block))
+void FirstU(const uint32_t is[8], const uint32_t os[8], const uint8_t* salt, size_t saltLen,
+            uint32_t block, uint32_t u[8]) {
+    uint8_t be[4];
+    store_be32(be, block);
+    uint32_t inner[8];
+    Sha256 h(is, 64);
+    h.Update(salt, saltLen);
+    h.Update(be, 4);
+    h.Final(inner);
+    uint8_t d[32];
+    for (int k = 0; k < 8; ++k) store_be32(d + 4 * k, inner[k]);
+    Sha256 o(os, 64);
+    o.Update(d, 32);
+    o.Final(u);
+    SecureZero(inner, sizeof(inner));
+    SecureZero(d, sizeof(d));
+}
+
+#if defined(AESGCM_X86)
+
+#define SHANI_TARGET AESGCM_TARGET("sha,ssse3,sse4.1")
+
+// One block on the SHA extensions. abef/cdgh hold the state in the
+// instructions' layout; w is the message as 16 words (word 0 in lane 0).
+SHANI_TARGET AESGCM_INLINE void ShaNiCompress(__m128i& abef, __m128i& cdgh, const uint32_t w[16]) {
+    const __m128i abef0 = abef, cdgh0 = cdgh;
+    __m128i m[4];
+    for (int i = 0; i < 4; ++i) m[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + 4 * i));
+    for (int g = 0; g < 16; ++g) {
+        // group g = words 4g..4g+3; m[g & 3] still holds group g - 4
+        if (g >= 4) {
+            __m128i t = _mm_sha256msg1_epu32(m[g & 3], m[(g + 1) & 3]);
+            t = _mm_add_epi32(t, _mm_alignr_epi8(m[(g + 3) & 3], m[(g + 2) & 3], 4));
+            m[g & 3] = _mm_sha256msg2_epu32(t, m[(g + 3) & 3]);
+        }
+        __m128i wk = _mm_add_epi32(m[g & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(K + 4 * g)));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+    }
+    abef = _mm_add_epi32(abef, abef0);
+    cdgh = _mm_add_epi32(cdgh, cdgh0);
+}
+
+SHANI_TARGET AESGCM_INLINE void ShaNiLoad(const uint32_t s[8], __m128i& abef, __m128i& cdgh) {
+    __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 4)), 0x1B);
+    abef = _mm_alignr_epi8(dcba, efgh, 8);
+    cdgh = _mm_blend_epi16(efgh, dcba, 0xF0);
+}
+
+SHANI_TARGET AESGCM_INLINE void ShaNiStore(__m128i abef, __m128i cdgh, uint32_t s[8]) {
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(s), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(s + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+// Iterate<uint32_t> on SHA-NI: the pad states stay in instruction layout
+SHANI_TARGET
+void ShaNiIterate(const uint32_t is[8], const uint32_t os[8], uint32_t u[8], uint32_t t[8],
+                  uint32_t count) {
+    __m128i iabef, icdgh, oabef, ocdgh;
+    ShaNiLoad(is, iabef, icdgh);
+    ShaNiLoad(os, oabef, ocdgh);
+    alignas(16) uint32_t w[16] = {0};
+    w[8] = kDigestPadBit;
+    w[15] = kDigestMsgBits;
+    __m128i t0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t));
+    __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + 4));
+    std::memcpy(w, u, 32);
+    for (uint32_t it = 0; it < count; ++it) {
+        __m128i abef = iabef, cdgh = icdgh;
+        ShaNiCompress(abef, cdgh, w);
+        ShaNiStore(abef, cdgh, w);
+        abef = oabef;
+        cdgh = ocdgh;
+        ShaNiCompress(abef, cdgh, w);
+        ShaNiStore(abef, cdgh, w);
+        t0 = _mm_xor_si128(t0, _mm_load_si128(reinterpret_cast<const __m128i*>(w)));
+        t1 = _mm_xor_si128(t1, _mm_load_si128(reinterpret_cast<const __m128i*>(w + 4)));
+    }
+    std::memcpy(u, w, 32);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(t), t0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(t + 4), t1);
+    SecureZero(w, sizeof(w));
+}
+
+#endif // AESGCM_X86
+
+#if defined(PBKDF2_LANES)
+
+typedef uint32_t U32x4 __attribute__((vector_size(16)));
+typedef uint32_t U32x8 __attribute__((vector_size(32)));
+
+AESGCM_TARGET("sse2")
+void IterateSse2x4(const U32x4 is[8], const U32x4 os[8], U32x4 u[8], U32x4 t[8], uint32_t count) {
+    Iterate(is, os, u, t, count);
+}
+
+AESGCM_TARGET("avx2")
+void IterateAvx2x8(const U32x8 is[8], const U32x8 os[8], U32x8 u[8], U32x8 t[8], uint32_t count) {
+    Iterate(is, os, u, t, count);
+}
+
+// N jobs (N = lanes of V) through one lane loop: scalar setup per lane, then
+// the state is transposed once and stays in lanes for every iteration
+template <class V, int N>
+void DeriveLanes(const Pbkdf2Job* jobs, uint32_t iterations,
+                 void (*iterate)(const V*, const V*, V*, V*, uint32_t)) {
+    V is[8], os[8], u[8], t[8];
+    uint32_t li[8], lo[8], lu[8];
+    for (int l = 0; l < N; ++l) {
+        HmacPads(jobs[l].pass, jobs[l].passLen, li, lo);
+        FirstU(li, lo, jobs[l].salt, jobs[l].saltLen, 1, lu);
+        for (int k = 0; k < 8; ++k) {
+            is[k][l] = li[k];
+            os[k][l] = lo[k];
+            u[k][l] = lu[k];
+        }
+    }
+    for (int k = 0; k < 8; ++k) t[k] = u[k];
+    iterate(is, os, u, t, iterations - 1);
+    for (int l = 0; l < N; ++l)
+        for (int k = 0; k < 8; ++k) store_be32(jobs[l].out + 4 * k, t[k][l]);
+
+    SecureZero(li, sizeof(li));
+    SecureZero(lo, sizeof(lo));
+    SecureZero(lu, sizeof(lu));
+    SecureZero(is, sizeof(is));
+    SecureZero(os, sizeof(os));
+    SecureZero(u, sizeof(u));
+    SecureZero(t, sizeof(t));
+}
+
+// Groups of N; the last partial group repeats its first job in the idle lanes
+template <class V, int N>
+void DeriveBatch(const Pbkdf2Job* jobs, size_t n, uint32_t iterations,
+                 void (*iterate)(const V*, const V*, V*, V*, uint32_t)) {
+    size_t i = 0;
+    for (; i + N <= n; i += N) DeriveLanes<V, N>(jobs + i, iterations, iterate);
+    if (i == n) return;
+    Pbkdf2Job group[N];
+    uint8_t scratch[N][32];
+    for (int l = 0; l < N; ++l) {
+        group[l] = i + l < n ? jobs[i + l] : jobs[i];
+        if (i + l >= n) group[l].out = scratch[l];
+    }
+    DeriveLanes<V, N>(group, iterations, iterate);
+    SecureZero(scratch, sizeof(scratch));
+}
+
+#endif // PBKDF2_LANES
+
+} // namespace
+
+bool Pbkdf2BackendSupported(Pbkdf2Backend b) {
+    const CpuFeatures& cpu = GetCpuFeatures();
+    switch (b) {
+    case Pbkdf2Backend::Portable: return true;
+    case Pbkdf2Backend::ShaNi: return cpu.sha && cpu.ssse3 && cpu.sse41;
+#if defined(PBKDF2_LANES)
+    case Pbkdf2Backend::Sse2x4: return cpu.sse2;
+    case Pbkdf2Backend::Avx2x8: return cpu.avx2;
+#else
+    case Pbkdf2Backend::Sse2x4:
+    case Pbkdf2Backend::Avx2x8: return false;
+#endif
+    }
+    return false;
+}
+
+Pbkdf2Backend Pbkdf2DefaultBackend() {
+    return Pbkdf2BackendSupported(Pbkdf2Backend::ShaNi) ? Pbkdf2Backend::ShaNi : Pbkdf2Backend::Portable;
+}
+
+Pbkdf2Backend Pbkdf2BatchBackend() {
+    if (Pbkdf2BackendSupported(Pbkdf2Backend::Avx2x8)) return Pbkdf2Backend::Avx2x8;
+    if (Pbkdf2BackendSupported(Pbkdf2Backend::Sse2x4)) return Pbkdf2Backend::Sse2x4;
+    return Pbkdf2DefaultBackend();
+}
+
+void PBKDF2_HMAC_SHA256(const uint8_t* pass, size_t passLen,
+                        const uint8_t* salt, size_t saltLen,
+                        uint32_t iterations, uint8_t* out, size_t outLen,
+                        Pbkdf2Backend backend) {
+    if (iterations == 0) throw std::invalid_argument("PBKDF2 needs at least one iteration");
+    if (!Pbkdf2BackendSupported(backend)) throw std::invalid_argument("PBKDF2 backend not supported on this CPU");
+    // lane engines only pay off across several derivations
+    if (backend != Pbkdf2Backend::ShaNi) backend = Pbkdf2Backend::Portable;
+
+    uint32_t is[8], os[8], u[8], t[8];
+    HmacPads(pass, passLen, is, os);
+    for (uint32_t block = 1; outLen > 0; ++block) {
+        FirstU(is, os, salt, saltLen, block, u);
+        std::memcpy(t, u, sizeof(t));
+#if defined(AESGCM_X86)
+        if (backend == Pbkdf2Backend::ShaNi) ShaNiIterate(is, os, u, t, iterations - 1);
+        else
+#endif
+            Iterate<uint32_t>(is, os, u, t, iterations - 1);
+        uint8_t be[32];
+        for (int k = 0; k < 8; ++k) store_be32(be + 4 * k, t[k]);
+        size_t n = outLen < 32 ? outLen : 32;
+        std::memcpy(out, be, n);
+        SecureZero(be, sizeof(be));
+        out += n;
+        outLen -= n;
+    }
+    SecureZero(is, sizeof(is));
+    SecureZero(os, sizeof(os));
+    SecureZero(u, sizeof(u));
+    SecureZero(t, sizeof(t));
+}
+
+void PBKDF2_HMAC_SHA256_Batch(const Pbkdf2Job* jobs, size_t n, uint32_t iterations,
+                              Pbkdf2Backend backend) {
+    if (iterations == 0) throw std::invalid_argument("PBKDF2 needs at least one iteration");
+    if (!Pbkdf2BackendSupported(backend)) throw std::invalid_argument("PBKDF2 backend not supported on this CPU");
+#if defined(PBKDF2_LANES)
+    if (backend == Pbkdf2Backend::Avx2x8) return DeriveBatch<U32x8, 8>(jobs, n, iterations, IterateAvx2x8);
+    if (backend == Pbkdf2Backend::Sse2x4) return DeriveBatch<U32x4, 4>(jobs, n, iterations, IterateSse2x4);
+#endif
+    for (size_t i = 0; i < n; ++i)
+        PBKDF2_HMAC_SHA256(jobs[i].pass, jobs[i].passLen, jobs[i].salt, jobs[i].saltLen,
+                           iterations, jobs[i].out, 32, backend);
+}
@@ -0,0 +1,50 @@
+#ifndef PBKDF2_H
+#define PBKDF2_H
+
+#include <cstddef>
+#include <cstdint>
+
+// In-tree PBKDF2-HMAC-SHA256 (RFC 8018), no OS crypto library needed.
+//
+// Almost all of the cost is the iteration loop: two SHA-256 compressions per
+// iteration on a 32-byte message with fixed padding. A single derivation
+// runs that loop on SHA-NI when the CPU has it. A batch runs 4 or 8
+// independent derivations side by side, one per SIMD lane. The lane state
+// stays transposed for the whole loop, so thousands of per-file salts cost
+// roughly 1/8 of deriving them one by one.
+
+// SHA-256 engine. Portable = scalar C++, ShaNi = SHA extensions (one
+// derivation at a time), Sse2x4 / Avx2x8 = 4 / 8 derivations per pass
+// (batches only; a single derivation falls back to ShaNi or Portable).
+enum class Pbkdf2Backend { Portable, ShaNi, Sse2x4, Avx2x8 };
+
+bool Pbkdf2BackendSupported(Pbkdf2Backend b);
+// ShaNi when available, otherwise Portable
+Pbkdf2Backend Pbkdf2DefaultBackend();
+// Widest lane engine the CPU has (Avx2x8, then Sse2x4), otherwise the default
+Pbkdf2Backend Pbkdf2BatchBackend();
+
+// outLen bytes of key from pass and salt. Throws std::invalid_argument if
+// iterations is 0 or the backend is not supported on this CPU.
+void PBKDF2_HMAC_SHA256(const uint8_t* pass, size_t passLen,
+                        const uint8_t* salt, size_t saltLen,
+                        uint32_t iterations, uint8_t* out, size_t outLen,
+                        Pbkdf2Backend backend = Pbkdf2DefaultBackend());
+
+// One derivation of a batch; out receives 32 bytes (one SHA-256 block of
+// output, the size of an AES-256 key)
+struct Pbkdf2Job {
+    const uint8_t* pass;
+    size_t passLen;
+    const uint8_t* salt;
+    size_t saltLen;
+    uint8_t* out;
+};
+
+// n independent derivations with the same iteration count. Output is the
+// same as calling PBKDF2_HMAC_SHA256(..., 32) per job; a final partial group
+// runs with idle lanes.
+void PBKDF2_HMAC_SHA256_Batch(const Pbkdf2Job* jobs, size_t n, uint32_t iterations,
+                              Pbkdf2Backend backend = Pbkdf2BatchBackend());
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SECURE_ZERO_H
+#define SECURE_ZERO_H
+
+#include <cstddef>
+#include <cstring>
+
+// Zero n bytes so the store survives even when the buffer is never read
+// again (destructors, evicted key material). GCC/Clang: plain memset plus a
+// compiler barrier that claims to read the buffer; elsewhere a volatile loop.
+inline void SecureZero(void* p, size_t n) {
+#if defined(__GNUC__)
+    std::memset(p, 0, n);
+    __asm__ __volatile__("" : : "r"(p) : "memory");
+#else
+    volatile unsigned char* v = static_cast<volatile unsigned char*>(p);
+    while (n--) *v++ = 0;
+#endif
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer / single-consumer queue. One thread pushes, one
+// other thread pops; no locks, one acquire/release pair per operation, and
+// head and tail live on separate cache lines so the two sides do not share
+// a line. Push blocks while the ring is full (backpressure on the faster
+// stage), Pop while it is empty. Both give up and return false once the
+// shared abort flag is set, so one failing stage can unblock the others.
+template <class T>
+class SpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        if (capacity == 0) throw std::invalid_argument("ring capacity must be non-zero");
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots.resize(n);
+        mask = n - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    bool TryPush(const T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) return false;
+        slots[t & mask] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        v = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Push(const T& v, const std::atomic<bool>& abort) {
+        for (unsigned spins = 0; !TryPush(v); ++spins) {
+            if (abort.load(std::memory_order_relaxed)) return false;
+            Backoff(spins);
+        }
+        return true;
+    }
+
+    bool Pop(T& v, const std::atomic<bool>& abort) {
+        for (unsigned spins = 0; !TryPop(v); ++spins) {
+            if (abort.load(std::memory_order_relaxed)) return false;
+            Backoff(spins);
+        }
+        return true;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0}; // next slot to pop
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to push
+
+    // Stages wait on each other for whole chunks (a disk read or an AES pass),
+    // so after a short spin the waiter yields and then sleeps
+    static void Backoff(unsigned spins) {
+        if (spins < 64) return;
+        if (spins < 256) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+#include <exception>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        size_t hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 0;
+    }
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) workers.emplace_back([this] { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Pull indices until the current job runs dry. Called with m unlocked.
+void ThreadPool::RunIndices() {
+    for (;;) {
+        size_t i;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (next >= jobSize) return;
+            i = next++;
+        }
+        try {
+            (*job)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(m);
+            if (!error) error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lk(m);
+        if (++finished == jobSize) done.notify_all();
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    size_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(m);
+            wake.wait(lk, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+        }
+        RunIndices();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+    if (workers.empty() || n == 1) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    std::lock_guard<std::mutex> run(runMutex);
+    {
+        std::lock_guard<std::mutex> lk(m);
+        job = &fn;
+        jobSize = n;
+        next = 0;
+        finished = 0;
+        error = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+    RunIndices();
+
+    std::unique_lock<std::mutex> lk(m);
+    done.wait(lk, [&] { return finished == jobSize; });
+    job = nullptr;
+    jobSize = 0;
+    std::exception_ptr e = error;
+    error = nullptr;
+    lk.unlock();
+    if (e) std::rethrow_exception(e);
+}
@@ -0,0 +1,53 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool for data-parallel jobs (parallel GCM and friends).
+// ParallelFor is the only entry point: it hands out indices 0..n-1, the
+// calling thread works on them too, and it returns once every index is done.
+class ThreadPool {
+public:
+    // threads = 0 -> std::thread::hardware_concurrency() - 1 workers
+    // (the caller is the extra thread)
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run a ParallelFor: the workers plus the caller
+    size_t Concurrency() const { return workers.size() + 1; }
+
+    // Runs fn(i) for i in [0, n). The first exception thrown by fn is
+    // rethrown here after all indices have finished. Calls are serialized.
+    void ParallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+    // Process-wide pool, created on first use
+    static ThreadPool& Shared();
+
+private:
+    void WorkerLoop();
+    void RunIndices();
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex; // one ParallelFor at a time
+
+    std::mutex m;
+    std::condition_variable wake, done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobSize = 0;
+    size_t next = 0;       // next index to hand out
+    size_t finished = 0;   // indices completed
+    size_t generation = 0; // bumped per job so workers join each one once
+    bool stop = false;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "Utils.h"
+#include "PBKDF2.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#elif defined(__linux__)
+#include <sys/random.h>
+#include <cerrno>
+#endif
+
+// =============================================
+// Utility: convert hex string → bytes
+// =============================================
+std::vector<uint8_t> hexToBytes(const std::string& hex)
+{
+    std::vector<uint8_t> out;
+    if (hex.size() % 2 != 0) return out;
+
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        uint8_t b = std::stoi(hex.substr(i, 2), nullptr, 16);
+        out.push_back(b);
+    }
+    return out;
+}
+
+// =============================================
+// Convert big decimal string → hex string
+// Implement big integer div-by-16 manually
+// =============================================
+
+std::string decToHex(const std::string& decStr)
+{
+    std::string num = decStr;
+    std::string hex = "";
+    const char* HEX = "0123456789ABCDEF";
+
+    while (!(num.size() == 1 && num[0] == '0')) {
+        int carry = 0;
+        std::string next = "";
+
+        for (char c : num) {
+            int cur = carry * 10 + (c - '0');
+            int q = cur / 16;
+            carry = cur % 16;
+
+            if (!(next.empty() && q == 0))
+                next.push_back('0' + q);
+        }
+
+        hex.push_back(HEX[carry]);
+
+        if (next.empty()) next = "0";
+        num = next;
+    }
+
+    std::reverse(hex.begin(), hex.end());
+    return hex;
+}
+
+// Base64 encode (simple, for small buffers like TAG)
+std::string toBase64(const std::vector<uint8_t>& data)
+{
+    static const char* tbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    while (i + 2 < data.size()) {
+        uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out.push_back(tbl[(n >> 18) & 63]);
+        out.push_back(tbl[(n >> 12) & 63]);
+        out.push_back(tbl[(n >> 6) & 63]);
+        out.push_back(tbl[n & 63]);
+        i += 3;
+    }
+    if (i + 1 < data.size()) {
+        uint32_t n = (data[i] << 16) | (data[i + 1] << 8);
+        out.push_back(tbl[(n >> 18) & 63]);
+        out.push_back(tbl[(n >> 12) & 63]);
+        out.push_back(tbl[(n >> 6) & 63]);
+        out.push_back('=');
+    } else if (i < data.size()) {
+        uint32_t n = (data[i] << 16);
+        out.push_back(tbl[(n >> 18) & 63]);
+        out.push_back(tbl[(n >> 12) & 63]);
+        out.push_back('=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+std::string bytesToHex(const std::vector<uint8_t>& data)
+{
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    out.reserve(data.size() * 2);
+    for (auto b : data) {
+        out.push_back(digits[b >> 4]);
+        out.push_back(digits[b & 15]);
+    }
+    return out;
+}
+
+// Cryptographically strong random bytes (system RNG)
+std::vector<uint8_t> randomBytes(size_t n)
+{
+    std::vector<uint8_t> buf(n);
+    if (n == 0) return buf;
+#ifdef _WIN32
+    NTSTATUS st = BCryptGenRandom(nullptr, buf.data(), (ULONG)buf.size(), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+    if (!BCRYPT_SUCCESS(st)) return {};
+#elif defined(__linux__)
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = getrandom(buf.data() + got, n - got, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return {};
+        }
+        got += (size_t)r;
+    }
+#else
+    FILE* f = std::fopen("/dev/urandom", "rb");
+    if (!f) return {};
+    size_t got = std::fread(buf.data(), 1, n, f);
+    std::fclose(f);
+    if (got != n) return {};
+#endif
+    return buf;
+}
+
+// PBKDF2-HMAC-SHA256 to derive 32-byte key from passphrase + salt
+// (in-tree implementation, same result as BCryptDeriveKeyPBKDF2)
+std::vector<uint8_t> deriveKeyPBKDF2(const std::string& pass, const std::vector<uint8_t>& salt, uint32_t iterations)
+{
+    if (iterations == 0) return {};
+    std::vector<uint8_t> out(32, 0);
+    PBKDF2_HMAC_SHA256((const uint8_t*)pass.data(), pass.size(), salt.data(), salt.size(),
+                       iterations, out.data(), out.size());
+    return out;
+}
+
+// Many salts, one passphrase: derived side by side in SIMD lanes
+std::vector<std::vector<uint8_t>> deriveKeysPBKDF2(const std::string& pass,
+                                                   const std::vector<std::vector<uint8_t>>& salts,
+                                                   uint32_t iterations)
+{
+    if (iterations == 0) return {};
+    std::vector<std::vector<uint8_t>> keys(salts.size(), std::vector<uint8_t>(32, 0));
+    std::vector<Pbkdf2Job> jobs(salts.size());
+    for (size_t i = 0; i < salts.size(); ++i)
+        jobs[i] = {(const uint8_t*)pass.data(), pass.size(), salts[i].data(), salts[i].size(), keys[i].data()};
+    PBKDF2_HMAC_SHA256_Batch(jobs.data(), jobs.size(), iterations);
+    return keys;
+}
+
+
+// =============================================
+// Auto-detect DEC or HEX input → convert to 32-byte key
+// =============================================
+std::vector<uint8_t> normalizeKey(std::string keyIn, bool* detectedDecimal)
+{
+    bool isDecimal = std::all_of(keyIn.begin(), keyIn.end(), ::isdigit);
+    if (detectedDecimal) *detectedDecimal = isDecimal;
+
+    std::string hex;
+
+    if (isDecimal)
+    {
+        hex = decToHex(keyIn);
+    }
+    else
+    {
+        hex = keyIn;
+    }
+
+    // Remove spaces
+    hex.erase(std::remove(hex.begin(), hex.end(), ' '), hex.end());
+
+    // Pad or trim to 32 bytes (64 hex chars)
+    if (hex.size() < 64)
+    {
+        hex.insert(hex.begin(), 64 - hex.size(), '0');
+    }
+    else if (hex.size() > 64)
+    {
+        hex = hex.substr(hex.size() - 64);
+    }
+
+    return hexToBytes(hex);
+}
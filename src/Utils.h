@@ -0,0 +1,41 @@
+#ifndef UTILS_H
+#define UTILS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Key/encoding helpers shared by the GUI (main.cpp) and the CLI (cli.cpp).
+
+// hex string -> bytes (empty on odd length)
+std::vector<uint8_t> hexToBytes(const std::string& hex);
+
+// big decimal string -> hex string (manual div-by-16)
+std::string decToHex(const std::string& decStr);
+
+// Base64 encode (simple, for small buffers like TAG)
+std::string toBase64(const std::vector<uint8_t>& data);
+
+// lowercase hex, two digits per byte
+std::string bytesToHex(const std::vector<uint8_t>& data);
+
+// Cryptographically strong random bytes from the OS (BCryptGenRandom on
+// Windows, getrandom / /dev/urandom elsewhere); empty vector on failure
+std::vector<uint8_t> randomBytes(size_t n);
+
+// PBKDF2-HMAC-SHA256 -> 32-byte key (PBKDF2.h, SHA-NI when available);
+// empty vector if iterations is 0
+std::vector<uint8_t> deriveKeyPBKDF2(const std::string& pass, const std::vector<uint8_t>& salt,
+                                     uint32_t iterations = 100000);
+
+// One 32-byte key per salt, 4 or 8 derivations at a time in SIMD lanes
+std::vector<std::vector<uint8_t>> deriveKeysPBKDF2(const std::string& pass,
+                                                   const std::vector<std::vector<uint8_t>>& salts,
+                                                   uint32_t iterations = 100000);
+
+// Auto-detect DEC or HEX input -> 32-byte key (pad/trim to 64 hex chars).
+// Silent; detectedDecimal (optional) reports which format was found.
+std::vector<uint8_t> normalizeKey(std::string keyIn, bool* detectedDecimal = nullptr);
+
+#endif
@@ -0,0 +1,98 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+namespace {
+// Which pool/deque the current thread works for (nullptr on non-workers)
+thread_local const WorkStealingPool* tlsPool = nullptr;
+thread_local size_t tlsIndex = 0;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    if (threads == 0) threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) workers.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void WorkStealingPool::Submit(Task task) {
+    size_t q = (tlsPool == this) ? tlsIndex : nextQueue.fetch_add(1) % queues.size();
+    {
+        std::lock_guard<std::mutex> lk(m);
+        ++pending;
+    }
+    {
+        std::lock_guard<std::mutex> lk(queues[q]->m);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    {
+        // under m so a worker between its check and its wait cannot miss it
+        std::lock_guard<std::mutex> lk(m);
+        queued.fetch_add(1);
+    }
+    wake.notify_one();
+}
+
+bool WorkStealingPool::TryPop(size_t self, Task& task) {
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lk(own.m);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues.size(); ++k) {
+        Queue& victim = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lk(victim.m);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(size_t self) {
+    tlsPool = this;
+    tlsIndex = self;
+    for (;;) {
+        Task task;
+        if (!TryPop(self, task)) {
+            std::unique_lock<std::mutex> lk(m);
+            wake.wait(lk, [&] { return stop || queued.load() > 0; });
+            if (stop) return;
+            continue;
+        }
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(m);
+            if (!error) error = std::current_exception();
+        }
+        task = nullptr; // release captures before reporting completion
+        std::lock_guard<std::mutex> lk(m);
+        if (--pending == 0) idle.notify_all();
+    }
+}
+
+void WorkStealingPool::Wait() {
+    std::unique_lock<std::mutex> lk(m);
+    idle.wait(lk, [&] { return pending == 0; });
+    std::exception_ptr e = error;
+    error = nullptr;
+    lk.unlock();
+    if (e) std::rethrow_exception(e);
+}
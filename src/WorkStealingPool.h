@@ -0,0 +1,61 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Task pool for many small, unevenly sized jobs (one file each, directory
+// walks that spawn more jobs). Every worker owns a deque: tasks submitted from
+// a worker go to its own deque and are popped LIFO (cache-warm), idle workers
+// steal FIFO from the others. Submit from outside is spread round-robin.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads = 0 -> std::thread::hardware_concurrency()
+    explicit WorkStealingPool(size_t threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t Size() const { return workers.size(); }
+
+    // Safe from any thread, including from inside a running task
+    void Submit(Task task);
+
+    // Block until every submitted task (and everything they submitted) has
+    // run. Rethrows the first exception a task let escape.
+    void Wait();
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    bool TryPop(size_t self, Task& task);
+    void WorkerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex m;
+    std::condition_variable wake;  // workers: work arrived or stop
+    std::condition_variable idle;  // Wait(): pending hit zero
+    std::atomic<size_t> queued{0}; // tasks sitting in deques
+    size_t pending = 0;            // submitted but not finished (guarded by m)
+    std::atomic<size_t> nextQueue{0};
+    bool stop = false;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,448 @@
+// Headless batch front end (Linux): encrypt or decrypt whole directory trees
+// or file lists concurrently. Same key rules and file layout as the GUI:
+//   <file>.gcm      = [Salt(16)] || IV(12) || ciphertext
+//   <file>.gcm.tag  = 16-byte TAG (like tag_output.bin)
+// or, with -c, one seekable chunked container per file (GCM_Chunked.h):
+//   <file>.gcmc     = header (salt inside) || chunk || tag || chunk || tag ...
+//
+// Build (repo root; add -DAESGCM_INSTRUMENT for the -S phase counters):
+//   g++ -std=c++17 -O2 -pthread src/cli.cpp src/AES_256.cpp src/AES_Bitslice.cpp src/AES_NI.cpp
+//       src/BufferPool.cpp src/CpuFeatures.cpp src/GCM.cpp src/GCM_Chunked.cpp src/GCM_CLMUL.cpp src/GCM_Pipeline.cpp src/GCM_VAES.cpp
+//       src/Instrument.cpp src/MappedFile.cpp src/Nonce.cpp src/PBKDF2.cpp src/ThreadPool.cpp src/Utils.cpp src/WorkStealingPool.cpp -o out/gcm-cli
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "GCM.h"
+#include "GCM_Chunked.h"
+#include "GCM_Pipeline.h"
+#include "Instrument.h"
+#include "MappedFile.h"
+#include "Nonce.h"
+#include "Utils.h"
+#include "WorkStealingPool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kCipherExt = ".gcm";
+const char* kTagExt = ".tag";
+const char* kContainerExt = ".gcmc";
+const uint32_t kPbkdfIterations = 100000;
+
+void usage() {
+    std::cerr <<
+        "Usage: gcm-cli encrypt|decrypt|verify -k KEY [-a AAD_FILE] [-o OUT_DIR] [-j THREADS]\n"
+        "               [-l LIST_FILE] [-t TAG_FILE] [-c] [-P] [-D] [-S STATS_FILE]\n"
+        "               [PATH...]\n"
+        "  KEY       DEC or HEX (pad/trim to 32 byte), 'pass:...' for PBKDF2, '-' = read stdin\n"
+        "  PATH      file or directory (walked recursively); LIST_FILE has one path per line\n"
+        "  encrypt   FILE -> FILE.gcm + FILE.gcm.tag (directories skip *.gcm / *.tag)\n"
+        "  decrypt   FILE.gcm (+ FILE.gcm.tag) or FILE.gcmc -> FILE (directories only pick\n"
+        "            *.gcm / *.gcmc)\n"
+        "  verify    same inputs as decrypt; checks every TAG (GHASH only), writes nothing\n"
+        "  -t        TAG_FILE for a single input (e.g. cipher_output.bin + tag_output.bin)\n"
+        "  -c        encrypt to FILE.gcmc: chunked container, 1 MiB chunks each with its own\n"
+        "            tag, no separate .tag file, seekable (random-access decrypt)\n"
+        "  -P        .gcm files go through the read/encrypt/write pipeline (pread/pwrite,\n"
+        "            bounded buffers) instead of mmap; same output\n"
+        "  -D        -P with O_DIRECT (bypass the page cache for very large files)\n"
+        "  -S        write per-phase crypto counters as JSON to STATS_FILE at exit ('-' =\n"
+        "            stderr); zeros unless built with -DAESGCM_INSTRUMENT\n"
+        "  OUT_DIR   mirror the tree under OUT_DIR instead of writing next to the input\n";
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+struct Options {
+    bool decrypt = false;
+    bool verify = false; // decrypt's inputs, tag check only
+    std::string key;
+    std::string aadPath;
+    std::string outDir;
+    std::string tagPath;
+    std::string statsPath;
+    size_t threads = 0;
+    bool chunked = false;
+    bool pipeline = false;
+    bool direct = false;
+    std::vector<std::string> paths;
+};
+
+class BatchJob {
+public:
+    BatchJob(const Options& opt, WorkStealingPool& pool) : opt(opt), pool(pool) {}
+
+    void Setup() {
+        if (!opt.aadPath.empty()) aad = MappedFile::OpenRead(opt.aadPath);
+
+        if (opt.key.rfind("pass:", 0) == 0 || opt.key.rfind("PASS:", 0) == 0 || opt.key.rfind("Pass:", 0) == 0) {
+            usePBKDF = true;
+            passphrase = opt.key.substr(5);
+            if (!opt.decrypt) {
+                // one salt per run: a single PBKDF2 derivation instead of one per file
+                salt = randomBytes(16);
+                if (salt.empty()) throw std::runtime_error("cannot generate random salt");
+                keyed = ContextForSalt(salt);
+            }
+        } else {
+            std::vector<uint8_t> key = normalizeKey(opt.key);
+            keyed = std::make_shared<AES256_GCM>(key);
+            std::fill(key.begin(), key.end(), 0);
+        }
+    }
+
+    // Queue one command-line/list entry
+    void AddRoot(const std::string& path) {
+        std::error_code ec;
+        if (fs::is_directory(path, ec)) {
+            fs::path root(path);
+            pool.Submit([this, root] { WalkDir(root, root); });
+        } else {
+            fs::path file(path);
+            pool.Submit([this, file] { ProcessFile(file, file.filename()); });
+        }
+    }
+
+    void Report(double seconds) const {
+        std::cerr << (opt.verify ? "Verified " : opt.decrypt ? "Decrypted " : "Encrypted ") << done.load() << " files, "
+                  << bytes.load() << " bytes in " << seconds << " s";
+        if (failed.load()) std::cerr << ", " << failed.load() << " FAILED";
+        std::cerr << "\n";
+    }
+
+    bool AnyFailed() const { return failed.load() != 0; }
+
+private:
+    const Options& opt;
+    WorkStealingPool& pool;
+
+    MappedFile aad;
+    bool usePBKDF = false;
+    std::string passphrase;
+    std::vector<uint8_t> salt;
+    std::shared_ptr<const AES256_GCM> keyed; // raw key, or the run's salt when encrypting
+
+    // decrypt + passphrase: one derivation per distinct salt. Salts requested
+    // while a derivation runs are queued and derived together as one batch
+    // (SIMD lanes), so files with their own salts do not queue up one by one.
+    std::mutex saltMutex;
+    std::condition_variable saltDone;
+    std::map<std::vector<uint8_t>, std::shared_ptr<const AES256_GCM>> bySalt;
+    std::vector<std::vector<uint8_t>> pendingSalts;
+    bool deriving = false;
+
+    std::mutex logMutex;
+    std::atomic<uint64_t> done{0}, failed{0}, bytes{0};
+
+    std::shared_ptr<const AES256_GCM> ContextForSalt(const std::vector<uint8_t>& s) {
+        std::unique_lock<std::mutex> lk(saltMutex);
+        for (;;) {
+            auto it = bySalt.find(s);
+            if (it != bySalt.end()) return it->second;
+            if (std::find(pendingSalts.begin(), pendingSalts.end(), s) == pendingSalts.end())
+                pendingSalts.push_back(s);
+            if (deriving) {
+                saltDone.wait(lk);
+                continue;
+            }
+
+            // this thread derives everything queued so far, s included
+            deriving = true;
+            std::vector<std::vector<uint8_t>> batch;
+            batch.swap(pendingSalts);
+            lk.unlock();
+            std::vector<std::shared_ptr<const AES256_GCM>> ctxs;
+            try {
+                std::vector<std::vector<uint8_t>> keys = deriveKeysPBKDF2(passphrase, batch, kPbkdfIterations);
+                for (std::vector<uint8_t>& key : keys) {
+                    ctxs.push_back(std::make_shared<const AES256_GCM>(key));
+                    std::fill(key.begin(), key.end(), 0);
+                }
+            } catch (...) {
+                lk.lock();
+                deriving = false;
+                saltDone.notify_all();
+                throw;
+            }
+            lk.lock();
+            for (size_t i = 0; i < batch.size(); ++i) bySalt.emplace(batch[i], ctxs[i]);
+            deriving = false;
+            saltDone.notify_all();
+        }
+    }
+
+    // One task per directory; subdirectories and files become new tasks
+    void WalkDir(const fs::path& root, const fs::path& dir) {
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+            const fs::directory_entry& e = *it;
+            std::error_code tec;
+            if (e.is_directory(tec) && !e.is_symlink(tec)) {
+                fs::path sub = e.path();
+                pool.Submit([this, root, sub] { WalkDir(root, sub); });
+            } else if (e.is_regular_file(tec)) {
+                std::string name = e.path().filename().string();
+                bool isCipher = endsWith(name, kCipherExt) || endsWith(name, kContainerExt);
+                bool isTag = endsWith(name, std::string(kCipherExt) + kTagExt);
+                if (opt.decrypt ? !isCipher : (isCipher || isTag)) continue;
+                fs::path file = e.path();
+                pool.Submit([this, root, file] { ProcessFile(file, file.lexically_relative(root)); });
+            }
+        }
+        if (ec) Fail(dir.string(), ec.message());
+    }
+
+    fs::path OutputBase(const fs::path& file, const fs::path& rel) const {
+        if (opt.outDir.empty()) return file;
+        fs::path out = fs::path(opt.outDir) / rel;
+        std::error_code ec;
+        fs::create_directories(out.parent_path(), ec);
+        return out;
+    }
+
+    void ProcessFile(const fs::path& file, const fs::path& rel) {
+        try {
+            uint64_t n = opt.verify ? VerifyOne(file) : opt.decrypt ? DecryptOne(file, rel) : EncryptOne(file, rel);
+            bytes += n;
+            ++done;
+        } catch (const std::exception& ex) {
+            Fail(file.string(), ex.what());
+        }
+    }
+
+    uint64_t EncryptOne(const fs::path& file, const fs::path& rel) {
+        if (opt.chunked) return EncryptContainerOne(file, rel);
+        std::vector<uint8_t> iv(12);
+        if (!fastRandomBytes(iv.data(), iv.size())) throw std::runtime_error("cannot generate random IV");
+        std::string out = OutputBase(file, rel).string() + kCipherExt;
+        uint8_t tag[16];
+        if (opt.pipeline) {
+            AES256_GCM_Pipeline(*keyed, PipelineOptions())
+                .EncryptFile(file.string(), out, usePBKDF ? salt : std::vector<uint8_t>(), iv,
+                             aad.Data(), aad.Size(), tag);
+        } else {
+            // one file per worker already; keep each file on its own thread
+            EncryptFileMapped(*keyed, file.string(), out, usePBKDF ? salt : std::vector<uint8_t>(), iv,
+                              aad.Data(), aad.Size(), tag, nullptr);
+        }
+        std::ofstream ftag(out + kTagExt, std::ios::binary);
+        bool created = ftag.is_open();
+        ftag.write((const char*)tag, sizeof(tag));
+        ftag.close();
+        if (!ftag) {
+            // a .gcm without its tag can never be decrypted; drop both
+            std::error_code ec;
+            if (created) fs::remove(out + kTagExt, ec);
+            fs::remove(out, ec);
+            throw std::runtime_error("cannot write " + out + kTagExt);
+        }
+        return fs::file_size(file);
+    }
+
+    uint64_t DecryptOne(const fs::path& file, const fs::path& rel) {
+        std::string in = file.string();
+        if (endsWith(in, kContainerExt)) return DecryptContainerOne(file, rel);
+        uint8_t tag[16];
+        ReadTag(in, tag);
+        std::shared_ptr<const AES256_GCM> ctx = keyed;
+        size_t saltLen = 0;
+        if (usePBKDF) {
+            saltLen = 16;
+            std::vector<uint8_t> s(16);
+            std::ifstream fin(in, std::ios::binary);
+            if (!fin.read((char*)s.data(), s.size())) throw std::runtime_error("ciphertext file too short");
+            ctx = ContextForSalt(s);
+        }
+        std::string out = OutputBase(file, rel).string();
+        if (endsWith(out, kCipherExt)) out.resize(out.size() - std::strlen(kCipherExt));
+        else out += ".dec";
+        if (opt.pipeline) {
+            AES256_GCM_Pipeline(*ctx, PipelineOptions()).DecryptFile(in, out, saltLen, aad.Data(), aad.Size(), tag);
+        } else {
+            DecryptFileMapped(*ctx, in, out, saltLen, aad.Data(), aad.Size(), tag, nullptr);
+        }
+        return fs::file_size(out);
+    }
+
+    // FILE.gcm.tag, or -t
+    void ReadTag(const std::string& in, uint8_t tag[16]) const {
+        std::string path = opt.tagPath.empty() ? in + kTagExt : opt.tagPath;
+        std::ifstream ftag(path, std::ios::binary);
+        if (!ftag.read((char*)tag, 16)) throw std::runtime_error("missing or short " + path);
+    }
+
+    // Authenticates without decrypting: GHASH over the mapped ciphertext plus
+    // one AES block, no output file and no plaintext buffer
+    uint64_t VerifyOne(const fs::path& file) {
+        std::string in = file.string();
+        MappedFile src = MappedFile::OpenRead(in);
+        if (endsWith(in, kContainerExt)) {
+            if (src.Size() < AES256_GCM_Chunked::HeaderBytes) throw std::runtime_error("container too short");
+            AES256_GCM_Chunked container(*ContainerContext(src.Data()), src.Data());
+            container.Verify(src.Data(), src.Size(), aad.Data(), aad.Size(), nullptr);
+            return container.PlaintextSize(src.Size());
+        }
+        uint8_t tag[16];
+        ReadTag(in, tag);
+        size_t saltLen = usePBKDF ? 16 : 0;
+        if (src.Size() < saltLen + 12) throw std::runtime_error("ciphertext file too short");
+        std::shared_ptr<const AES256_GCM> ctx = keyed;
+        if (usePBKDF) ctx = ContextForSalt(std::vector<uint8_t>(src.Data(), src.Data() + saltLen));
+        size_t len = src.Size() - saltLen - 12;
+        if (!ctx->Verify(src.Data() + saltLen, 12, src.Data() + saltLen + 12, len, aad.Data(), aad.Size(), tag))
+            throw std::runtime_error("GCM authentication failed!");
+        return len;
+    }
+
+    // Key for a container: the raw key, or the one derived from its salt
+    std::shared_ptr<const AES256_GCM> ContainerContext(const uint8_t* header) {
+        if (!usePBKDF) return keyed;
+        std::vector<uint8_t> s = AES256_GCM_Chunked::ReadSalt(header);
+        if (s.empty()) throw std::runtime_error("container has no salt (not a pass: key)");
+        return ContextForSalt(s);
+    }
+
+    uint64_t EncryptContainerOne(const fs::path& file, const fs::path& rel) {
+        std::string out = OutputBase(file, rel).string() + kContainerExt;
+        AES256_GCM_Chunked container(*keyed, AES256_GCM_Chunked::DefaultChunkBytes,
+                                     usePBKDF ? salt : std::vector<uint8_t>());
+        MappedFile src = MappedFile::OpenRead(file.string());
+        MappedFile dst = MappedFile::CreateReplacing(
+            out, size_t(AES256_GCM_Chunked::ContainerSize(src.Size(), container.ChunkBytes())));
+        container.Encrypt(src.Data(), src.Size(), aad.Data(), aad.Size(), dst.Data(), nullptr);
+        dst.Close();
+        return src.Size();
+    }
+
+    uint64_t DecryptContainerOne(const fs::path& file, const fs::path& rel) {
+        MappedFile src = MappedFile::OpenRead(file.string());
+        if (src.Size() < AES256_GCM_Chunked::HeaderBytes) throw std::runtime_error("container too short");
+        AES256_GCM_Chunked container(*ContainerContext(src.Data()), src.Data());
+        std::string out = OutputBase(file, rel).string();
+        out.resize(out.size() - std::strlen(kContainerExt));
+        // every chunk tag verifies before the temporary replaces out
+        MappedFile dst = MappedFile::CreateReplacing(out, size_t(container.PlaintextSize(src.Size())));
+        container.Decrypt(src.Data(), src.Size(), aad.Data(), aad.Size(), dst.Data(), nullptr);
+        dst.Close();
+        return fs::file_size(out);
+    }
+
+    // one crypto worker per file: the pool already runs one file per thread
+    AES256_GCM_Pipeline::Options PipelineOptions() const {
+        AES256_GCM_Pipeline::Options o;
+        o.direct = opt.direct;
+        return o;
+    }
+
+    void Fail(const std::string& path, const std::string& why) {
+        ++failed;
+        std::lock_guard<std::mutex> lk(logMutex);
+        std::cerr << "[LOI] " << path << ": " << why << "\n";
+    }
+};
+
+void writeStats(const std::string& path) {
+    std::string json = GcmStatsJson() + "\n";
+    if (path == "-") {
+        std::cerr << json;
+        return;
+    }
+    std::ofstream out(path);
+    out << json;
+    if (!out) std::cerr << "[LOI] cannot write " << path << "\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    if (argc < 2) return false;
+    std::string cmd = argv[1];
+    if (cmd == "encrypt") opt.decrypt = false;
+    else if (cmd == "decrypt") opt.decrypt = true;
+    else if (cmd == "verify") opt.decrypt = opt.verify = true;
+    else return false;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("missing value for " + a);
+            return argv[++i];
+        };
+        if (a == "-k") opt.key = value();
+        else if (a == "-a") opt.aadPath = value();
+        else if (a == "-o") opt.outDir = value();
+        else if (a == "-t") opt.tagPath = value();
+        else if (a == "-S") opt.statsPath = value();
+        else if (a == "-j") opt.threads = std::stoul(value());
+        else if (a == "-c") opt.chunked = true;
+        else if (a == "-P") opt.pipeline = true;
+        else if (a == "-D") opt.pipeline = opt.direct = true;
+        else if (a == "-l") {
+            std::string listPath = value();
+            std::ifstream list(listPath);
+            if (!list) throw std::runtime_error("cannot open list " + listPath);
+            for (std::string line; std::getline(list, line);) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) opt.paths.push_back(line);
+            }
+        } else if (!a.empty() && a[0] == '-') {
+            throw std::invalid_argument("unknown option " + a);
+        } else {
+            opt.paths.push_back(a);
+        }
+    }
+    if (!opt.tagPath.empty() && (!opt.decrypt || opt.paths.size() != 1))
+        throw std::invalid_argument("-t takes the tag of a single file to decrypt or verify");
+    if (opt.key == "-") std::getline(std::cin, opt.key);
+    return !opt.key.empty() && !opt.paths.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    try {
+        if (!parseArgs(argc, argv, opt)) {
+            usage();
+            return 2;
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\n";
+        usage();
+        return 2;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    WorkStealingPool pool(opt.threads);
+    BatchJob job(opt, pool);
+    try {
+        job.Setup();
+        for (const std::string& p : opt.paths) job.AddRoot(p);
+        pool.Wait();
+    } catch (const std::exception& ex) {
+        pool.Wait();
+        std::cerr << "[LOI] " << ex.what() << "\n";
+        if (!opt.statsPath.empty()) writeStats(opt.statsPath);
+        return 1;
+    }
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    job.Report(dt.count());
+    if (!opt.statsPath.empty()) writeStats(opt.statsPath);
+    return job.AnyFailed() ? 1 : 0;
+}
@@ -10,168 +10,18 @@
 #include <sstream>
 #include <algorithm>
 #include <limits>
+#include <cstdio>
+#include <stdexcept>
 
 #pragma comment(lib, "bcrypt")
 
 
 #include "AES_256.h"
+#include "BufferPool.h"
 #include "GCM.h"
+#include "GCM_Stream.h"
 #include "GMAC.h"
-
-// =============================================
-// Utility: convert hex string → bytes
-// =============================================
-std::vector<uint8_t> hexToBytes(const std::string& hex)
-{
-    std::vector<uint8_t> out;
-    if (hex.size() % 2 != 0) return out;
-
-    for (size_t i = 0; i < hex.size(); i += 2)
-    {
-        uint8_t b = std::stoi(hex.substr(i, 2), nullptr, 16);
-        out.push_back(b);
-    }
-    return out;
-}
-
-// =============================================
-// Convert big decimal string → hex string
-// Implement big integer div-by-16 manually
-// =============================================
-
-std::string decToHex(const std::string& decStr)
-{
-    std::string num = decStr;
-    std::string hex = "";
-    const char* HEX = "0123456789ABCDEF";
-
-    while (!(num.size() == 1 && num[0] == '0')) {
-        int carry = 0;
-        std::string next = "";
-
-        for (char c : num) {
-            int cur = carry * 10 + (c - '0');
-            int q = cur / 16;
-            carry = cur % 16;
-
-            if (!(next.empty() && q == 0))
-                next.push_back('0' + q);
-        }
-
-        hex.push_back(HEX[carry]);
-
-        if (next.empty()) next = "0";
-        num = next;
-    }
-
-    std::reverse(hex.begin(), hex.end());
-    return hex;
-}
-
-// Base64 encode (simple, for small buffers like TAG)
-std::string toBase64(const std::vector<uint8_t>& data)
-{
-    static const char* tbl = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    std::string out;
-    size_t i = 0;
-    while (i + 2 < data.size()) {
-        uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
-        out.push_back(tbl[(n >> 18) & 63]);
-        out.push_back(tbl[(n >> 12) & 63]);
-        out.push_back(tbl[(n >> 6) & 63]);
-        out.push_back(tbl[n & 63]);
-        i += 3;
-    }
-    if (i + 1 < data.size()) {
-        uint32_t n = (data[i] << 16) | (data[i + 1] << 8);
-        out.push_back(tbl[(n >> 18) & 63]);
-        out.push_back(tbl[(n >> 12) & 63]);
-        out.push_back(tbl[(n >> 6) & 63]);
-        out.push_back('=');
-    } else if (i < data.size()) {
-        uint32_t n = (data[i] << 16);
-        out.push_back(tbl[(n >> 18) & 63]);
-        out.push_back(tbl[(n >> 12) & 63]);
-        out.push_back('=');
-        out.push_back('=');
-    }
-    return out;
-}
-
-std::string bytesToHex(const std::vector<uint8_t>& data)
-{
-    std::ostringstream oss;
-    oss << std::hex << std::setw(2) << std::setfill('0');
-    for (auto b : data) oss << (int)b;
-    return oss.str();
-}
-
-// Cryptographically strong random bytes (system RNG)
-std::vector<uint8_t> randomBytes(size_t n)
-{
-    std::vector<uint8_t> buf(n);
-    if (n == 0) return buf;
-    NTSTATUS st = BCryptGenRandom(nullptr, buf.data(), (ULONG)buf.size(), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
-    if (!BCRYPT_SUCCESS(st)) return {};
-    return buf;
-}
-
-// PBKDF2-HMAC-SHA256 to derive 32-byte key from passphrase + salt
-std::vector<uint8_t> deriveKeyPBKDF2(const std::string& pass, const std::vector<uint8_t>& salt, ULONG iterations = 100000)
-{
-    BCRYPT_ALG_HANDLE hAlg = nullptr;
-    NTSTATUS st = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA256_ALGORITHM, NULL, BCRYPT_ALG_HANDLE_HMAC_FLAG);
-    if (!BCRYPT_SUCCESS(st)) return {};
-
-    std::vector<uint8_t> out(32, 0);
-    st = BCryptDeriveKeyPBKDF2(
-        hAlg,
-        (PUCHAR)pass.data(), (ULONG)pass.size(),
-        (PUCHAR)salt.data(), (ULONG)salt.size(),
-        iterations,
-        out.data(), (ULONG)out.size(),
-        0);
-    BCryptCloseAlgorithmProvider(hAlg, 0);
-    if (!BCRYPT_SUCCESS(st)) return {};
-    return out;
-}
-
-
-// =============================================
-// Auto-detect DEC or HEX input → convert to 32-byte key
-// =============================================
-std::vector<uint8_t> normalizeKey(std::string keyIn)
-{
-    bool isDecimal = std::all_of(keyIn.begin(), keyIn.end(), ::isdigit);
-
-    std::string hex;
-
-    if (isDecimal)
-    {
-        std::cout << "Detected DEC → converting to HEX...\n";
-        hex = decToHex(keyIn);
-    }
-    else
-    {
-        std::cout << "Detected HEX input\n";
-        hex = keyIn;
-    }
-
-    // Remove spaces
-    hex.erase(std::remove(hex.begin(), hex.end(), ' '), hex.end());
-
-    // Pad or trim to 32 bytes (64 hex chars)
-    if (hex.size() < 64)
-    {
-        hex.insert(hex.begin(), 64 - hex.size(), '0');
-    }
-    else if (hex.size() > 64)
-    {
-        hex = hex.substr(hex.size() - 64);
-    }
-
-    return hexToBytes(hex);
-}
+#include "Utils.h"
 
 // -----------------------------------------------
 // Select a file and return its path (UTF-8)
@@ -207,11 +57,39 @@ std::string pickFilePath()
     return path;
 }
 
-std::vector<uint8_t> readFileBytes(const std::string& path)
+// Files are processed in fixed-size chunks so memory use does not grow with file size
+const size_t kFileChunk = 1 << 20; // 1 MiB
+
+uint64_t fileSize(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return 0;
+    return (uint64_t)f.tellg();
+}
+
+// Plaintext chunk buffers: locked in RAM (best effort) and wiped on release.
+// The pool keeps the block between runs, so encrypting again reuses it.
+BufferPool& secretPool()
 {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) return {};
-    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), {});
+    static BufferPool pool([] {
+        BufferPoolOptions opt;
+        opt.lock = true;
+        return opt;
+    }());
+    return pool;
+}
+
+// Read `in` to the end in kFileChunk pieces (buf holds kFileChunk bytes),
+// calling fn(data, len) for each. Returns false on a read error.
+template <typename Fn>
+bool forEachChunk(std::istream& in, uint8_t* buf, Fn fn)
+{
+    while (in) {
+        in.read((char*)buf, (std::streamsize)kFileChunk);
+        std::streamsize got = in.gcount();
+        if (got > 0) fn(buf, (size_t)got);
+    }
+    return in.eof() && !in.bad();
 }
 
 // =================================================================
@@ -223,6 +101,7 @@ namespace {
     HWND g_hStatus = nullptr;
     HWND g_hDataLabel = nullptr;
     HWND g_hSigLabel = nullptr;
+    HWND g_hSelfCheck = nullptr;
     RECT g_dataRect{20, 110, 480, 300};
     RECT g_sigRect{520, 110, 980, 300};
     Gdiplus::Bitmap* g_imgData = nullptr;
@@ -286,13 +165,18 @@ namespace {
         }
 
         AppendStatus("Dang doc file...\r\n");
-        auto plaintext = readFileBytes(g_dataPath);
-        auto signature = readFileBytes(g_sigPath);
-        if (plaintext.empty() || signature.empty()) {
+        uint64_t plainSize = fileSize(g_dataPath);
+        uint64_t sigSize = fileSize(g_sigPath);
+        if (plainSize == 0 || sigSize == 0) {
             AppendStatus("[LOI] Khong the doc file.\r\n");
             MessageBoxW(NULL, L"Doc file that bai", L"Loi", MB_ICONERROR);
             return;
         }
+        if (plainSize > AES256_GCM::MaxMessageBytes) {
+            AppendStatus("[LOI] File qua lon cho mot thong diep GCM (toi da ~64 GiB).\r\n");
+            MessageBoxW(NULL, L"File qua lon", L"Loi", MB_ICONERROR);
+            return;
+        }
 
         bool usePBKDF = false;
         std::vector<uint8_t> salt;
@@ -315,8 +199,9 @@ namespace {
             }
             AppendStatus("PBKDF2-HMAC-SHA256 (100k) tu passphrase.\r\n");
         } else {
-            key = normalizeKey(key_in);
-            AppendStatus("Key OK (hex/dec). Dang ma hoa...\r\n");
+            bool isDec = false;
+            key = normalizeKey(key_in, &isDec);
+            AppendStatus(isDec ? "Key DEC -> HEX. Dang ma hoa...\r\n" : "Key HEX. Dang ma hoa...\r\n");
         }
 
         auto iv = randomBytes(12);
@@ -328,29 +213,64 @@ namespace {
 
         AES256_GCM gcm(key);
         std::vector<uint8_t> tag_encrypt;
-
-        auto ciphertext = gcm.Encrypt(iv, plaintext, signature, tag_encrypt);
-
-        try {
-            auto decrypted = gcm.Decrypt(iv, ciphertext, signature, tag_encrypt);
-            (void)decrypted;
-        } catch (...) {
-            AppendStatus("[LOI] TAG khong hop le sau khi ma hoa?!\r\n");
-            MessageBoxW(NULL, L"TAG khong hop le", L"Loi", MB_ICONERROR);
-            return;
+        BufferPool::Buffer chunk = secretPool().Acquire(kFileChunk);
+        uint8_t* buf = chunk.Data();
+        size_t prefixLen = (usePBKDF ? salt.size() : 0) + iv.size();
+
+        // Stream: AAD file, then input file chunk by chunk -> cipher_output.bin
+        {
+            std::ofstream fout("cipher_output.bin", std::ios::binary);
+            if (!fout) {
+                AppendStatus("[LOI] Khong the mo cipher_output.bin de ghi.\r\n");
+                MessageBoxW(NULL, L"Ghi file that bai", L"Loi", MB_ICONERROR);
+                return;
+            }
+            if (usePBKDF) {
+                fout.write((char*)salt.data(), salt.size()); // prefix SALT
+            }
+            fout.write((char*)iv.data(), iv.size()); // prefix IV
+
+            AES256_GCM_Stream enc(gcm);
+            enc.Init(iv, AES256_GCM_Stream::Mode::Encrypt);
+            std::ifstream fsig(g_sigPath, std::ios::binary);
+            bool ok = forEachChunk(fsig, buf, [&](uint8_t* p, size_t n) { enc.UpdateAAD(p, n); });
+            std::ifstream fin(g_dataPath, std::ios::binary);
+            ok = ok && forEachChunk(fin, buf, [&](uint8_t* p, size_t n) {
+                enc.Update(p, p, n); // in place
+                fout.write((char*)p, n);
+            });
+            if (!ok || !fout || enc.MessageBytes() != plainSize) {
+                fout.close();
+                std::remove("cipher_output.bin"); // truncated, no tag
+                AppendStatus("[LOI] Loi doc/ghi file khi ma hoa.\r\n");
+                MessageBoxW(NULL, L"Ma hoa that bai", L"Loi", MB_ICONERROR);
+                return;
+            }
+            enc.Final(tag_encrypt);
         }
 
-        std::ofstream fout("cipher_output.bin", std::ios::binary);
-        if (!fout) {
-            AppendStatus("[LOI] Khong the mo cipher_output.bin de ghi.\r\n");
-            MessageBoxW(NULL, L"Ghi file that bai", L"Loi", MB_ICONERROR);
-            return;
-        }
-        if (usePBKDF) {
-            fout.write((char*)salt.data(), salt.size()); // prefix SALT
+        // Optional self-check: re-read the written file and verify the TAG in
+        // chunks. Verify mode runs GHASH only (no second AES pass, no plaintext).
+        if (SendMessageW(g_hSelfCheck, BM_GETCHECK, 0, 0) == BST_CHECKED) {
+            AppendStatus("Kiem tra lai TAG...\r\n");
+            std::ifstream fchk("cipher_output.bin", std::ios::binary);
+            fchk.seekg((std::streamoff)prefixLen);
+            AES256_GCM_Stream chk(gcm);
+            chk.Init(iv, AES256_GCM_Stream::Mode::Verify);
+            std::ifstream fsig(g_sigPath, std::ios::binary);
+            bool ok = forEachChunk(fsig, buf, [&](uint8_t* p, size_t n) { chk.UpdateAAD(p, n); });
+            ok = ok && forEachChunk(fchk, buf, [&](uint8_t* p, size_t n) { chk.Update(p, n); });
+            try {
+                if (!ok) throw std::runtime_error("read error");
+                chk.FinalVerify(tag_encrypt);
+            } catch (...) {
+                std::remove("cipher_output.bin");
+                AppendStatus("[LOI] TAG khong hop le sau khi ma hoa?!\r\n");
+                MessageBoxW(NULL, L"TAG khong hop le", L"Loi", MB_ICONERROR);
+                return;
+            }
         }
-        fout.write((char*)iv.data(), iv.size()); // prefix IV
-        fout.write((char*)ciphertext.data(), ciphertext.size());
+        chunk.Release();
 
         std::ofstream ftag("tag_output.bin", std::ios::binary);
         if (ftag) ftag.write((char*)tag_encrypt.data(), tag_encrypt.size());
@@ -364,11 +284,11 @@ namespace {
                 ftagTxt << "Salt (hex): " << bytesToHex(salt) << "\n";
                 ftagTxt << "PBKDF2: HMAC-SHA256, 100000 vong\n";
             }
-            ftagTxt << "Cipher bytes: " << ciphertext.size() << "\n";
+            ftagTxt << "Cipher bytes: " << plainSize << "\n";
         }
 
         std::ostringstream oss;
-        oss << "Cipher: " << ciphertext.size() << " bytes\r\n";
+        oss << "Cipher: " << plainSize << " bytes\r\n";
         oss << "IV (hex): " << bytesToHex(iv) << "\r\n";
         if (usePBKDF) {
             oss << "Salt (hex): " << bytesToHex(salt) << " (PBKDF2-HMAC-SHA256, 100k)\r\n";
@@ -395,6 +315,8 @@ namespace {
 
             CreateWindowW(L"BUTTON", L"Ma hoa + Tao TAG", WS_VISIBLE | WS_CHILD, 380, 50, 180, 32, hWnd, (HMENU)1003, NULL, NULL);
 
+            g_hSelfCheck = CreateWindowW(L"BUTTON", L"Kiem tra lai TAG", WS_VISIBLE | WS_CHILD | BS_AUTOCHECKBOX, 380, 85, 180, 20, hWnd, (HMENU)1004, NULL, NULL);
+
             CreateWindowW(L"BUTTON", L"Chọn Chữ Ký", WS_VISIBLE | WS_CHILD, 700, 50, 180, 28, hWnd, (HMENU)1002, NULL, NULL);
             g_hSigLabel = CreateWindowW(L"STATIC", L"(chua chon)", WS_VISIBLE | WS_CHILD, 700, 85, 220, 20, hWnd, NULL, NULL, NULL);
 